@@ -65,7 +65,7 @@ typedef struct {
 
 typedef struct {
 	omniscio_op_type 	type;
-	omniscio_file 		fh;	// not yet supported
+	omniscio_file 		fh;	// last handle of the file, if known
 	omniscio_offset 	offset;
 	omniscio_size 		size;
 	omniscio_date 		date;
@@ -73,6 +73,51 @@ typedef struct {
 	double			proba;
 } omniscio_req;
 
+typedef struct {
+	long		rules_created;		// rules created by the grammar
+	long		rules_destroyed;	// rules removed from the grammar
+	long		matches;		// calls to match
+	long		substitutions;		// calls to substitute
+	long		expansions;		// calls to expand
+	long		digrams;		// current size of the digram table
+	long		predictors;		// current number of predictors
+	long		predictor_searches;	// calls to find_new_predictors
+	long		inputs;			// symbols inserted in the grammar
+	long long	input_time;		// time spent inserting symbols (ns)
+	long		rebuilds;		// predictor rebuilds (lazy mode)
+	long		refusals;		// matches refused (OMNISCIO_MAX_DEPTH)
+	long		freezes;		// switches to the frozen mode
+	long		frozen_inputs;		// symbols followed, not learned
+	long long	learning_time;		// time in the learning mode (ns)
+	long long	frozen_time;		// time in the frozen mode (ns)
+	long		callsite_hits;		// symbols found without unwinding
+	long		callsite_misses;	// stacks fully unwound
+	long		async_drops;		// operations lost, queue full
+	long		async_backlog;		// longest queue seen
+	long		threads;		// threads traced, not yet exited
+	long long	log_dropped;		// log bytes lost, file system late
+	long		overhead_skipped;	// operations not learned, over budget
+	long		overhead_level;		// highest degradation level reached
+	long		overhead_current;	// highest level of the threads now
+} omniscio_stats;
+
+typedef enum {
+	OMNISCIO_STAGE_UNWIND,		// capturing the call stack
+	OMNISCIO_STAGE_DICTIONARY,	// converting it into a symbol
+	OMNISCIO_STAGE_MODEL,		// feeding the symbol to the grammar
+	OMNISCIO_STAGE_TRACKERS,	// time, size, offset and type tables
+	OMNISCIO_STAGE_LOGGING,		// writing the operation in the log
+	OMNISCIO_STAGE_TOTAL		// whole time spent in Omnisc'IO
+} omniscio_stage;
+
+typedef struct {
+	long		count;	// operations that went through the stage
+	long long	total;	// time spent in the stage (ns)
+	long long	p50;	// median time (ns)
+	long long	p99;	// 99th percentile (ns)
+	long long	max;	// longest time (ns)
+} omniscio_profile;
+
 enum {
 	OMNISCIO_OK 	= 0,
 	OMNISCIO_ERROR 	= -1
@@ -146,9 +191,26 @@ int omniscio_file_from_mpiio(omniscio_file* result, MPI_File fh);
  * array is allocated and should be freed using omniscio_predict_free.
  * The size of the array is given by n after the call to the function.
  * n can be equal to 0 if Omnisc'IO has not been able to make a prediction.
+ * If the OMNISCIO_ASYNC environment variable is set, the predictions are
+ * the last ones published by the background thread, which may not have
+ * seen the latest operations yet.
  */
 int omniscio_next(omniscio_req** prediction, int* n);
 
+/**
+ * Same as omniscio_next, but fills an array provided by the caller
+ * without allocating any memory, so that it can be called before every
+ * I/O operation. Only the predictions with a probability of at least
+ * threshold are kept, at most cap of them, the most probable first.
+ * The number of predictions written is given by n after the call.
+ * Note that in lazy mode (OMNISCIO_LAZY) the first call after an
+ * operation rebuilds the predictors from the last operations only, so
+ * that more operations may be predicted, and that in asynchronous mode
+ * (OMNISCIO_ASYNC) the first call feeds the queued operations to the
+ * model.
+ */
+int omniscio_next_into(omniscio_req* buf, int cap, double threshold, int* n);
+
 /**
  * Frees the array allocated by omniscio_predict_next.
  */
@@ -166,19 +228,72 @@ int omniscio_free(omniscio_req* prediction);
  */
 int omniscio_predict_from(int index, omniscio_req** predicted, int n);
 
+/**
+ * Fills the provided structure with statistics on the grammar
+ * maintained by Omnisc'IO. If the OMNISCIO_STATS environment variable
+ * is set, these statistics are also written in a .stats file when
+ * calling omniscio_finalize.
+ */
+int omniscio_get_stats(omniscio_stats* stats);
+
+/**
+ * Fills the provided structure with the time spent by Omnisc'IO in one
+ * stage of the operations of the given type, when the OMNISCIO_PROFILE
+ * environment variable is set (OMNISCIO_ERROR otherwise). The
+ * dictionary stage is skipped when the call site cache knows the symbol.
+ * The total covers both the start and the end of an operation. These
+ * profiles are also written in a .profile file when calling
+ * omniscio_finalize.
+ */
+int omniscio_get_profile(omniscio_op_type op, omniscio_stage stage,
+		omniscio_profile* profile);
+
+/**
+ * Gives in ns the time below which the given percentage (between 0 and
+ * 100) of the operations of the given type spent in the stage, read
+ * from a histogram with a relative error below 1/8.
+ */
+int omniscio_get_percentile(omniscio_op_type op, omniscio_stage stage,
+		double percent, long long* ns);
+
+/**
+ * Gives the same symbols to the same call stacks on all the processes
+ * and writes a single dictionary for all of them. Collective over
+ * MPI_COMM_WORLD. Done by omniscio_finalize if the OMNISCIO_UNIFY
+ * environment variable is set. Meant to be called once, at the end of
+ * the run: the call stacks seen for the first time after it are given
+ * local symbols again, which may be the same on different processes.
+ */
+int omniscio_unify(void);
+
 /**
  * Finalizes Omnisc'IO. Should be called before calling MPI_Finalize.
  */
 int omniscio_finalize(void);
 
+/**
+ * Process-wide switch, set between omniscio_init and omniscio_finalize.
+ */
 extern int omniscio_tracing_enabled;
 
+/**
+ * Per-thread flag, set while a thread is inside Omnisc'IO or inside a
+ * call that must not be traced. Other threads keep being traced.
+ */
+extern __thread int omniscio_untraced;
+
+/**
+ * Returns the address of the calling thread's omniscio_untraced flag,
+ * for the wrappers that only find Omnisc'IO with dlsym.
+ */
+int* omniscio_untraced_flag(void);
+
 #define OMNISCIO_UNTRACED_START \
-	int __ote = omniscio_tracing_enabled; \
-	omniscio_tracing_enabled = 0;
+	int __ote = omniscio_untraced; \
+	omniscio_untraced = 1;
 
 #define OMNISCIO_UNTRACED_END \
-	omniscio_tracing_enabled = __ote;
+	omniscio_untraced = __ote;
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,180 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <cmath>
+#include <cstring>
+#include "binlog.hpp"
+
+namespace omniscio {
+
+static const char 	BINLOG_MAGIC[8] = {'O','M','N','I','B','L','O','G'};
+static const unsigned 	BINLOG_VERSION 	= 1;
+static const size_t 	BINLOG_HEADER 	= 16; // magic + version + record size
+static const size_t 	BINLOG_RECORD 	= 48;
+static const unsigned 	BINLOG_LONG 	= 0xffffffff; // duration follows
+
+static inline void put_fixed(unsigned char* buf, unsigned long long v, size_t n)
+{
+	for(size_t i = 0; i < n; i++) buf[i] = (unsigned char)(v >> (8*i));
+}
+
+static inline unsigned long long get_fixed(const unsigned char* buf, size_t n)
+{
+	unsigned long long v = 0;
+	for(size_t i = 0; i < n; i++) v |= (unsigned long long)buf[i] << (8*i);
+	return v;
+}
+
+static inline long long to_ns(omniscio_date d)
+{
+	return (long long)std::floor(d*1e9 + 0.5);
+}
+
+binlog_writer::binlog_writer()
+: out(NULL) {}
+
+void binlog_writer::open(std::ostream& o)
+{
+	unsigned char header[BINLOG_HEADER];
+	std::memcpy(header,BINLOG_MAGIC,8);
+	put_fixed(header+8,BINLOG_VERSION,4);
+	put_fixed(header+12,BINLOG_RECORD,4);
+	out = &o;
+	out->write((const char*)header,BINLOG_HEADER);
+}
+
+void binlog_writer::write(const event& e)
+{
+	if(out == NULL) return;
+
+	long long start = to_ns(e.start);
+	long long duration = to_ns(e.end) - start;
+	size_t len = e.name == NULL ? 0 : std::strlen(e.name);
+	if(len > 0xffff) len = 0xffff;
+
+	// record, long duration and padding of the name
+	unsigned char buf[BINLOG_RECORD+8+8];
+	put_fixed(buf,start,8);
+	put_fixed(buf+8,e.offset,8);
+	put_fixed(buf+16,e.size,8);
+	put_fixed(buf+24,e.fd,8);
+	put_fixed(buf+32,(unsigned)e.sym,4);
+	put_fixed(buf+36,(unsigned)e.ret,4);
+	buf[44] = (unsigned char)e.op;
+	buf[45] = (unsigned char)e.api;
+	put_fixed(buf+46,len,2);
+	size_t n = BINLOG_RECORD;
+	if(duration >= 0 && duration < BINLOG_LONG) {
+		put_fixed(buf+40,duration,4);
+	} else {
+		put_fixed(buf+40,BINLOG_LONG,4);
+		put_fixed(buf+n,duration,8);
+		n += 8;
+	}
+	out->write((const char*)buf,n);
+
+	if(len != 0) {
+		out->write(e.name,len);
+		size_t pad = (8 - len % 8) % 8;
+		std::memset(buf,0,pad);
+		out->write((const char*)buf,pad);
+	}
+}
+
+void binlog_writer::close()
+{
+	if(out == NULL) return;
+	out->flush();
+	out = NULL;
+}
+
+binlog_reader::binlog_reader()
+: in(NULL), record_size(BINLOG_RECORD) {}
+
+bool binlog_reader::probe(std::istream& i)
+{
+	char magic[8];
+	std::streampos pos = i.tellg();
+	i.read(magic,8);
+	bool result = i.good() && (std::memcmp(magic,BINLOG_MAGIC,8) == 0);
+	i.clear();
+	i.seekg(pos);
+	return result;
+}
+
+bool binlog_reader::open(std::istream& i)
+{
+	unsigned char header[BINLOG_HEADER];
+	i.seekg(0);
+	i.read((char*)header,BINLOG_HEADER);
+	if(not i.good() || std::memcmp(header,BINLOG_MAGIC,8) != 0
+	|| get_fixed(header+8,4) != BINLOG_VERSION) return false;
+	// later versions may only append fields to the record
+	record_size = get_fixed(header+12,4);
+	if(record_size < BINLOG_RECORD) return false;
+	in = &i;
+	return true;
+}
+
+bool binlog_reader::next(event& e)
+{
+	if(in == NULL) return false;
+
+	unsigned char buf[BINLOG_RECORD];
+	in->read((char*)buf,BINLOG_RECORD);
+	if(not in->good()) return false;
+	if(record_size > BINLOG_RECORD) 
+		in->ignore(record_size - BINLOG_RECORD);
+
+	long long start = (long long)get_fixed(buf,8);
+	e.offset 	= (omniscio_offset)get_fixed(buf+8,8);
+	e.size 		= (omniscio_size)get_fixed(buf+16,8);
+	e.fd 		= (unsigned long)get_fixed(buf+24,8);
+	e.sym 		= (int)get_fixed(buf+32,4);
+	e.ret 		= (int)get_fixed(buf+36,4);
+	e.op 		= buf[44];
+	e.api 		= buf[45];
+	size_t len 	= get_fixed(buf+46,2);
+
+	long long duration = get_fixed(buf+40,4);
+	if(duration == BINLOG_LONG) {
+		in->read((char*)buf,8);
+		duration = (long long)get_fixed(buf,8);
+	}
+	e.name = NULL;
+	if(len != 0) {
+		name.resize(len);
+		in->read(&name[0],len);
+		in->ignore((8 - len % 8) % 8);
+		e.name = name.c_str();
+	}
+	e.start = (omniscio_date)start/1e9;
+	e.end = (omniscio_date)(start + duration)/1e9;
+	return in->good();
+}
+
+}
@@ -0,0 +1,118 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef OMNISCIO_BINLOG_H
+#define OMNISCIO_BINLOG_H
+
+#include <iostream>
+#include <string>
+#include "event.hpp"
+
+namespace omniscio {
+
+/**
+ * The binlog_writer class writes a stream of events in the binary log
+ * format: a header followed by one fixed-width record per event, in
+ * little-endian byte order. Dates are stored in nanoseconds.
+ *
+ * Header (16 bytes): magic "OMNIBLOG", version, record size.
+ * Record (48 bytes):
+ *  0 start (int64), 8 offset (int64), 16 size (uint64), 24 fd (uint64),
+ *  32 symbol (int32), 36 return value (int32), 40 duration (uint32),
+ *  44 operation (uint8), 45 API (uint8), 46 name length (uint16).
+ * A duration that does not fit in 32 bits is stored as 0xffffffff and
+ * followed by its int64 value. The file name of an open operation
+ * follows the record, padded to 8 bytes.
+ */
+class binlog_writer {
+
+	private:
+
+	std::ostream* 		out;
+
+	public:
+
+	binlog_writer();
+
+	/**
+	 * Starts writing a binary log in the provided stream.
+	 */
+	void open(std::ostream& o);
+
+	/**
+	 * Appends an event to the log.
+	 */
+	void write(const event& e);
+
+	/**
+	 * Flushes the log. The stream is not closed.
+	 */
+	void close();
+
+	bool is_open() const {
+		return out != NULL;
+	}
+};
+
+/**
+ * The binlog_reader class streams the events stored in a binary log.
+ */
+class binlog_reader {
+
+	private:
+
+	std::istream* 		in;
+	size_t 			record_size;
+	std::string 		name;
+
+	public:
+
+	binlog_reader();
+
+	/**
+	 * Checks whether the stream contains a binary log.
+	 * The position in the stream is restored.
+	 */
+	static bool probe(std::istream& i);
+
+	/**
+	 * Reads the header of the log and prepares to read events.
+	 * \return true in case of success, false otherwise.
+	 */
+	bool open(std::istream& i);
+
+	/**
+	 * Reads the next event. The name field, if not NULL, remains
+	 * valid until the next call.
+	 * \return false when no more event can be read.
+	 */
+	bool next(event& e);
+};
+
+}
+
+#endif
@@ -0,0 +1,141 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <cstring>
+#include <stdint.h>
+#include <time.h>
+#include <mpi.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+#include "clock.hpp"
+
+namespace omniscio {
+
+clock_reader now = clock_mpi;
+
+#define CALIBRATION_NS	10000000
+
+static inline double seconds(const struct timespec& ts)
+{
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+double clock_mpi(void)
+{
+	return MPI_Wtime();
+}
+
+double clock_raw(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW,&ts);
+	return seconds(ts);
+}
+
+double clock_coarse(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_COARSE,&ts);
+	return seconds(ts);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// seconds per tick, and date of the tick 0 on CLOCK_MONOTONIC
+static double _tsc_period_ = 0.0;
+static double _tsc_origin_ = 0.0;
+
+static inline uint64_t rdtsc()
+{
+	uint32_t lo, hi;
+	__asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+double clock_tsc(void)
+{
+	return _tsc_origin_ + rdtsc()*_tsc_period_;
+}
+
+/**
+ * Reads CLOCK_MONOTONIC and the counter at the same time, as the middle
+ * of the shortest of a few pairs of counter reads around the clock.
+ */
+static void sample(double& date, uint64_t& ticks)
+{
+	uint64_t best = ~(uint64_t)0;
+	for(int i = 0; i < 5; i++) {
+		struct timespec ts;
+		uint64_t before = rdtsc();
+		clock_gettime(CLOCK_MONOTONIC,&ts);
+		uint64_t after = rdtsc();
+		if(after - before < best) {
+			best = after - before;
+			date = seconds(ts);
+			ticks = before + (after - before)/2;
+		}
+	}
+}
+
+bool calibrate_tsc(void)
+{
+	// invariant TSC: constant rate, not stopped in deep C-states
+	unsigned int a, b, c, d;
+	if(not __get_cpuid(0x80000007,&a,&b,&c,&d) 
+	|| not (d & (1 << 8))) return false;
+
+	double start, end;
+	uint64_t start_ticks, end_ticks;
+	sample(start,start_ticks);
+	struct timespec wait = { 0, CALIBRATION_NS };
+	nanosleep(&wait,NULL);
+	sample(end,end_ticks);
+	if(end_ticks <= start_ticks || end <= start) return false;
+
+	_tsc_period_ = (end - start)/(end_ticks - start_ticks);
+	_tsc_origin_ = end - end_ticks*_tsc_period_;
+	return true;
+}
+
+#endif
+
+clock_reader find_clock(const char* name)
+{
+	if(name == NULL) return NULL;
+	if(std::strcmp(name,"mpi") == 0) return clock_mpi;
+	if(std::strcmp(name,"raw") == 0) return clock_raw;
+	if(std::strcmp(name,"coarse") == 0) return clock_coarse;
+#if defined(__x86_64__) || defined(__i386__)
+	if(std::strcmp(name,"tsc") == 0) 
+		return calibrate_tsc() ? clock_tsc : NULL;
+#endif
+	return NULL;
+}
+
+}
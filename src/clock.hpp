@@ -0,0 +1,88 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef OMNISCIO_CLOCK_H
+#define OMNISCIO_CLOCK_H
+
+namespace omniscio {
+
+/**
+ * A clock returns the current date in seconds. Only differences
+ * between dates taken with the same clock are meaningful.
+ */
+typedef double (*clock_reader)(void);
+
+/**
+ * Clock based on MPI_Wtime (a call into the MPI library, often
+ * followed by gettimeofday).
+ */
+double clock_mpi(void);
+
+/**
+ * Clock based on clock_gettime(CLOCK_MONOTONIC_RAW), read through the
+ * vDSO on Linux, not slewed by NTP.
+ */
+double clock_raw(void);
+
+/**
+ * Clock based on clock_gettime(CLOCK_MONOTONIC_COARSE), the cheapest
+ * one but only as precise as the scheduler tick (1 to 10 ms).
+ */
+double clock_coarse(void);
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * Clock based on the time stamp counter of the processor, converted
+ * with the frequency measured by calibrate_tsc. Only usable when
+ * the counter runs at a constant rate on all the cores.
+ */
+double clock_tsc(void);
+
+/**
+ * Measures the frequency of the time stamp counter against
+ * CLOCK_MONOTONIC, over about 10 ms.
+ * \return false if the counter is not invariant.
+ */
+bool calibrate_tsc(void);
+#endif
+
+/**
+ * Returns the clock corresponding to a name ("mpi", "raw", "coarse"
+ * or "tsc"), or NULL if the name is unknown or the clock is not
+ * usable on this machine. Calibrates the time stamp counter.
+ */
+clock_reader find_clock(const char* name);
+
+/**
+ * Clock used to date the operations, selected at initialization
+ * (see OMNISCIO_CLOCK).
+ */
+extern clock_reader now;
+
+}
+
+#endif
@@ -33,11 +33,47 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <cstring>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "tree.hpp"
+#include "writer.hpp"
 #include "omniscio.h"
 
 namespace omniscio {
 
+/**
+ * Hash function used by the dictionary to compute the fingerprint
+ * of a sequence, one letter at a time. The default version hashes
+ * the bytes of the letter (FNV-1a); it can be specialized for
+ * letter types that are not plain data.
+ */
+template<typename T>
+struct fingerprint {
+	uint64_t operator()(uint64_t h, const T& letter) const {
+		const unsigned char* b = (const unsigned char*)&letter;
+		for(size_t i = 0; i < sizeof(T); i++) {
+			h ^= b[i];
+			h *= 1099511628211ULL;
+		}
+		return h;
+	}
+};
+
+/**
+ * Addresses are hashed as a whole word.
+ */
+template<typename T>
+struct fingerprint<T*> {
+	uint64_t operator()(uint64_t h, T* const& letter) const {
+		h ^= (uint64_t)(uintptr_t)letter;
+		return h * 1099511628211ULL;
+	}
+};
+
 /**
  * The dictionary class represents a dictionary, that is, a
  * tree structure to associate a sequence of symbols of type T
@@ -54,6 +90,16 @@ namespace omniscio {
  *
  * In other parts of Omnisc'IO, the disctionary is used
  * to associate stack traces with integers.
+ *
+ * Sequences already in the dictionary are found through a hash
+ * table indexed by their fingerprint (see the fingerprint class)
+ * and compared letter by letter only when fingerprints are equal;
+ * the tree is only walked when inserting a new sequence.
+ *
+ * The fingerprint table and the letters can be saved in a binary
+ * file and mapped back by another run (see save and load), so that
+ * sequences keep their identifiers from one run to the next. T must
+ * then be plain data, and I an integer type.
  */
 template<typename T, typename I>
 class dictionary {
@@ -70,14 +116,62 @@ class dictionary {
 		}
 	};
 
+	// children of a node in the tree are looked up by letter
+	struct letter_of {
+		typedef T key_type;
+		const T& operator()(const node& n) const {
+			return n.letter;
+		}
+	};
+
+	typedef tree<node,letter_of> tree_type;
+
+	// entry of the fingerprint table, the sequence is stored
+	// in letters at [offset, offset+length).
+	struct slot {
+		uint64_t	hash;
+		size_t		offset;
+		size_t		length; // 0 if the slot is free
+		I		index;
+	};
+
 	I last_index;
 	I null_index;
-	tree<node> content;
+	tree_type content;
+
+	std::vector<slot> slots; // open addressing, size is a power of 2
+	size_t num_slots_used;
+	std::vector<T> letters;
 
-	std::ofstream file;
+	log_file file;
 	bool opened;
 	I last_written;
 
+	// binary file: a header, the fingerprint table (num_slots
+	// stored_slot) then the letters (num_letters T)
+	struct file_header {
+		char		magic[8];
+		uint32_t	version;
+		uint32_t	letter_size;
+		uint64_t	num_slots;
+		uint64_t	num_letters;
+		int64_t		last_index;
+	};
+
+	struct stored_slot {
+		uint64_t	hash;
+		uint64_t	offset;
+		uint64_t	length; // 0 if the slot is free
+		int64_t		index;
+	};
+
+	// sequences loaded from a binary file, read in place
+	void* mapped;
+	size_t mapped_size;
+	const stored_slot* loaded_slots;
+	size_t num_loaded_slots; // power of 2, 0 if nothing was loaded
+	const T* loaded_letters;
+
 	I generate_next_index() {
 		I i = last_index;
 		last_index += 1;
@@ -85,16 +179,163 @@ class dictionary {
 	}
 
 	template<typename ITERATOR>
-	I insert_recursive(typename tree<node>::iterator n,
+	static uint64_t hash(const ITERATOR& start, const ITERATOR& end) {
+		fingerprint<T> f;
+		uint64_t h = 14695981039346656037ULL;
+		for(ITERATOR it = start; it != end; ++it) {
+			h = f(h,*it);
+		}
+		// final mix, the low bits are used to index the table
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+	template<typename ITERATOR>
+	const slot* lookup(uint64_t h, const ITERATOR& start, size_t length) const {
+		if(slots.empty()) return NULL;
+		size_t mask = slots.size() - 1;
+		for(size_t i = h & mask; ; i = (i+1) & mask) {
+			const slot& s = slots[i];
+			if(s.length == 0) return NULL;
+			if(s.hash == h && s.length == length
+			&& std::equal(start, start+length, letters.begin()+s.offset))
+				return &s;
+		}
+	}
+
+	// a sequence of the dictionary, wherever it is stored
+	struct entry {
+		I		index;
+		const T*	seq;
+		size_t		length;
+
+		bool operator<(const entry& e) const { return index < e.index; }
+	};
+
+	void collect(std::vector<entry>& result) const {
+		entry e;
+		for(size_t i = 0; i < num_loaded_slots; i++) {
+			const stored_slot& s = loaded_slots[i];
+			if(s.length == 0) continue;
+			e.index = (I)s.index;
+			e.seq = loaded_letters + s.offset;
+			e.length = s.length;
+			result.push_back(e);
+		}
+		for(size_t i = 0; i < slots.size(); i++) {
+			const slot& s = slots[i];
+			if(s.length == 0) continue;
+			e.index = s.index;
+			e.seq = &letters[s.offset];
+			e.length = s.length;
+			result.push_back(e);
+		}
+		std::sort(result.begin(),result.end());
+	}
+
+	template<typename M>
+	void remap_tree(typename tree_type::iterator n, const M& m) {
+		for(; n != content.end(); n++) {
+			if(n->index != null_index && (size_t)n->index < m.size())
+				n->index = m[n->index];
+			remap_tree(n.begin(),m);
+		}
+	}
+
+	template<typename ITERATOR>
+	const stored_slot* lookup_loaded(uint64_t h, const ITERATOR& start,
+					size_t length) const {
+		if(num_loaded_slots == 0) return NULL;
+		size_t mask = num_loaded_slots - 1;
+		for(size_t i = h & mask; ; i = (i+1) & mask) {
+			const stored_slot& s = loaded_slots[i];
+			if(s.length == 0) return NULL;
+			if(s.hash == h && s.length == length
+			&& std::equal(start, start+length, loaded_letters+s.offset))
+				return &s;
+		}
+	}
+
+	// checks that the sequences of a loaded table lie within the
+	// letters, that their identifiers were given before last and
+	// that a lookup stops (at least one free slot)
+	bool valid_slots(const stored_slot* table, uint64_t n,
+			uint64_t num_letters, I last) const {
+		if(last <= null_index) return false;
+		bool free_slot = (n == 0);
+		for(uint64_t i = 0; i < n; i++) {
+			const stored_slot& s = table[i];
+			if(s.length == 0) {
+				free_slot = true;
+				continue;
+			}
+			if(s.offset > num_letters
+			|| s.length > num_letters - s.offset
+			|| (I)s.index <= null_index || (I)s.index >= last
+			|| s.index != (int64_t)(I)s.index)
+				return false;
+		}
+		return free_slot;
+	}
+
+	static void store(std::vector<stored_slot>& table, std::vector<T>& out,
+			uint64_t h, const T* seq, size_t length, I index) {
+		stored_slot s;
+		s.hash = h;
+		s.offset = out.size();
+		s.length = length;
+		s.index = index;
+		out.insert(out.end(),seq,seq+length);
+		size_t mask = table.size() - 1;
+		size_t i = h & mask;
+		while(table[i].length != 0) i = (i+1) & mask;
+		table[i] = s;
+	}
+
+	void place(const slot& s) {
+		size_t mask = slots.size() - 1;
+		size_t i = s.hash & mask;
+		while(slots[i].length != 0) i = (i+1) & mask;
+		slots[i] = s;
+	}
+
+	template<typename ITERATOR>
+	void remember(uint64_t h, const ITERATOR& start, size_t length, I index) {
+		// keeps the load factor under 1/2
+		if(2*(num_slots_used+1) > slots.size()) {
+			std::vector<slot> old;
+			old.swap(slots);
+			slot empty;
+			empty.length = 0;
+			slots.resize(old.empty() ? 64 : 2*old.size(), empty);
+			for(size_t i = 0; i < old.size(); i++) {
+				if(old[i].length != 0) place(old[i]);
+			}
+		}
+		slot s;
+		s.hash = h;
+		s.offset = letters.size();
+		s.length = length;
+		s.index = index;
+		letters.insert(letters.end(),start,start+length);
+		place(s);
+		num_slots_used += 1;
+	}
+
+	template<typename ITERATOR>
+	I insert_recursive(typename tree_type::iterator n,
 		const ITERATOR& start, const ITERATOR& end)
 	{
 		node current;
 		current.letter = *start;
 		current.index  = null_index;
 
-		typename tree<node>::iterator sbegin = n.begin();
-		typename tree<node>::iterator send   = n.end();
-		typename tree<node>::iterator found  = std::find(sbegin,send,current);
+		typename tree_type::iterator send  = n.end();
+		typename tree_type::iterator found = n.find_child(current);
 
 		if(found == send) {
 			if(start+1 == end) {
@@ -102,7 +343,7 @@ class dictionary {
 				n.append_child(current);
 				return current.index;
 			} else {
-				typename tree<node>::iterator c = 
+				typename tree_type::iterator c = 
 					n.append_child(current);
 				return insert_recursive(c,start+1,end);
 			}
@@ -118,6 +359,23 @@ class dictionary {
 		}
 	}
 
+	template<typename ITERATOR>
+	I insert_tree(const ITERATOR& start, const ITERATOR& end) {
+		// first time we store something
+		if(content.is_empty()) {
+			node n;
+			n.letter = *start;
+			n.index = null_index;
+			typename tree_type::iterator c =
+				content.add_root(n);
+			if(start+1 == end) {
+				c->index = generate_next_index();
+				return c->index;
+			}
+		} 
+		return insert_recursive(content.begin(),start,end);
+	}
+
 	class empty_container : public std::exception {
 
 		public:
@@ -134,8 +392,11 @@ class dictionary {
 	/**
 	 * Creates a dictionary.
  	 */
-	dictionary() : opened(false) {
+	dictionary() : null_index(), num_slots_used(0), opened(false),
+	mapped(NULL), mapped_size(0), loaded_slots(NULL),
+	num_loaded_slots(0), loaded_letters(NULL) {
 		last_index = null_index + 1;
+		last_written = null_index;
 	}
 
 	/**
@@ -147,9 +408,17 @@ class dictionary {
 	 * \param[in] filename : name of the file in which to store
 	 *			 the dictionary.
 	 */
-	dictionary(const std::string& filename) : opened(false) {
+	dictionary(const std::string& filename)
+	: null_index(), num_slots_used(0), opened(false),
+	mapped(NULL), mapped_size(0), loaded_slots(NULL),
+	num_loaded_slots(0), loaded_letters(NULL) {
 		open(filename);
 		last_index = null_index + 1;
+		last_written = null_index;
+	}
+
+	~dictionary() {
+		if(mapped != NULL) munmap(mapped,mapped_size);
 	}
 
 	/**
@@ -167,19 +436,15 @@ class dictionary {
 	I insert(const ITERATOR& start,
 		 const ITERATOR& end) throw(empty_container) {
 		if(start == end) throw empty_container();
-		// first time we store something
-		if(content.is_empty()) {
-			node n;
-			n.letter = *start;
-			n.index = null_index;
-			typename tree<node>::iterator c =
-				content.add_root(n);
-			if(start+1 == end) {
-				c->index = generate_next_index();
-				return c->index;
-			}
-		} 
-		return insert_recursive(content.begin(),start,end);
+		uint64_t h = hash(start,end);
+		size_t length = end - start;
+		const stored_slot* loaded = lookup_loaded(h,start,length);
+		if(loaded != NULL) return (I)loaded->index;
+		const slot* found = lookup(h,start,length);
+		if(found != NULL) return found->index;
+		I i = insert_tree(start,end);
+		remember(h,start,length,i);
+		return i;
 	}
 
 	/**
@@ -198,7 +463,8 @@ class dictionary {
 			OMNISCIO_UNTRACED_START;
 			file << "[" << i << "]:";
 			file << container;
-			file << std::endl;
+			file << '\n';
+			file.commit();
 			OMNISCIO_UNTRACED_END;
 			last_written = i;
 		}
@@ -224,6 +490,185 @@ class dictionary {
 		}
 	}
 
+	/**
+	 * Maps a binary file written by save, so that the sequences it
+	 * contains get back their identifiers. The file is used in place
+	 * and never modified. Only possible on an empty dictionary.
+	 * Files whose sequences lie outside of the letters are rejected.
+	 *
+	 * \param[in] filename : name of the binary file.
+	 * \return true in case of success, false otherwise.
+	 */
+	bool load(const std::string& filename) {
+		if(mapped != NULL || last_index != null_index + 1) return false;
+		OMNISCIO_UNTRACED_START;
+		void* m = MAP_FAILED;
+		struct stat st;
+		int fd = ::open(filename.c_str(),O_RDONLY);
+		if(fd != -1 && fstat(fd,&st) == 0 
+		&& (size_t)st.st_size >= sizeof(file_header)) {
+			// private mapping: remap changes identifiers
+			// in memory only
+			m = mmap(NULL,st.st_size,PROT_READ|PROT_WRITE,
+				MAP_PRIVATE,fd,0);
+		}
+		if(fd != -1) ::close(fd);
+		OMNISCIO_UNTRACED_END;
+		if(m == MAP_FAILED) return false;
+
+		const file_header* hd = (const file_header*)m;
+		size_t size = st.st_size;
+		uint64_t n = hd->num_slots;
+		if(std::memcmp(hd->magic,"OMNIDICT",8) != 0 || hd->version != 1
+		|| hd->letter_size != sizeof(T) || (n & (n-1)) != 0
+		|| hd->num_letters > size || n > size
+		|| sizeof(file_header) + n*sizeof(stored_slot)
+		   + hd->num_letters*sizeof(T) != size
+		|| not valid_slots((const stored_slot*)(hd+1),n,
+				hd->num_letters,(I)hd->last_index)) {
+			munmap(m,size);
+			return false;
+		}
+
+		mapped = m;
+		mapped_size = size;
+		loaded_slots = (const stored_slot*)(hd+1);
+		num_loaded_slots = n;
+		loaded_letters = (const T*)(loaded_slots+n);
+		last_index = (I)hd->last_index;
+		last_written = last_index - 1;
+		return true;
+	}
+
+	/**
+	 * Writes the sequences of the dictionary (including the loaded
+	 * ones) and their identifiers in a binary file that load can map.
+	 *
+	 * \param[in] filename : name of the binary file.
+	 * \return true in case of success, false otherwise.
+	 */
+	bool save(const std::string& filename) const {
+		size_t count = num_slots_used;
+		for(size_t i = 0; i < num_loaded_slots; i++)
+			if(loaded_slots[i].length != 0) count += 1;
+		size_t n = 64;
+		while(n < 2*count) n *= 2;
+
+		stored_slot empty;
+		std::memset(&empty,0,sizeof(empty));
+		std::vector<stored_slot> table(n,empty);
+		std::vector<T> out;
+		for(size_t i = 0; i < num_loaded_slots; i++) {
+			const stored_slot& s = loaded_slots[i];
+			if(s.length == 0) continue;
+			store(table,out,s.hash,loaded_letters+s.offset,
+				s.length,(I)s.index);
+		}
+		for(size_t i = 0; i < slots.size(); i++) {
+			const slot& s = slots[i];
+			if(s.length == 0) continue;
+			store(table,out,s.hash,&letters[s.offset],s.length,s.index);
+		}
+
+		file_header hd;
+		std::memset(&hd,0,sizeof(hd));
+		std::memcpy(hd.magic,"OMNIDICT",8);
+		hd.version = 1;
+		hd.letter_size = sizeof(T);
+		hd.num_slots = n;
+		hd.num_letters = out.size();
+		hd.last_index = last_index;
+
+		OMNISCIO_UNTRACED_START;
+		std::ofstream f(filename.c_str(),
+			std::ios_base::out | std::ios_base::binary);
+		f.write((const char*)&hd,sizeof(hd));
+		f.write((const char*)&table[0],n*sizeof(stored_slot));
+		if(not out.empty())
+			f.write((const char*)&out[0],out.size()*sizeof(T));
+		bool ok = f.good();
+		f.close();
+		OMNISCIO_UNTRACED_END;
+		return ok;
+	}
+
+	/**
+	 * Returns the identifier that the next new sequence will get.
+	 */
+	I next_index() const {
+		return last_index;
+	}
+
+	/**
+	 * Gets all the sequences of the dictionary, by increasing identifier.
+	 *
+	 * \param[out] ids : identifiers of the sequences.
+	 * \param[out] lengths : lengths of the sequences.
+	 * \param[out] seqs : the sequences, one after the other.
+	 */
+	void get_entries(std::vector<I>& ids, std::vector<size_t>& lengths,
+			std::vector<T>& seqs) const {
+		std::vector<entry> e;
+		collect(e);
+		for(size_t i = 0; i < e.size(); i++) {
+			ids.push_back(e[i].index);
+			lengths.push_back(e[i].length);
+			seqs.insert(seqs.end(),e[i].seq,e[i].seq+e[i].length);
+		}
+	}
+
+	/**
+	 * Renames the identifiers: i becomes m[i] (identifiers beyond the end
+	 * of m are left unchanged). New sequences will then be numbered
+	 * from next.
+	 *
+	 * \param[in] m : new identifier of each sequence.
+	 * \param[in] next : identifier of the next new sequence.
+	 */
+	template<typename M>
+	void remap(const M& m, I next) {
+		stored_slot* loaded = const_cast<stored_slot*>(loaded_slots);
+		for(size_t i = 0; i < num_loaded_slots; i++) {
+			stored_slot& s = loaded[i];
+			if(s.length != 0 && (size_t)s.index < m.size())
+				s.index = m[s.index];
+		}
+		for(size_t i = 0; i < slots.size(); i++) {
+			slot& s = slots[i];
+			if(s.length != 0 && (size_t)s.index < m.size())
+				s.index = m[s.index];
+		}
+		remap_tree(content.begin(),m);
+		last_index = next;
+		last_written = next - 1;
+	}
+
+	/**
+	 * Writes all the sequences of the dictionary in a text file, one
+	 * "[identifier]:letter;letter;..." line per sequence.
+	 *
+	 * \param[in] filename : name of the file.
+	 * \return true in case of success, false otherwise.
+	 */
+	bool write(const std::string& filename) const {
+		std::vector<entry> e;
+		collect(e);
+		OMNISCIO_UNTRACED_START;
+		std::ofstream f(filename.c_str());
+		for(size_t i = 0; i < e.size(); i++) {
+			f << "[" << e[i].index << "]:";
+			for(size_t j = 0; j < e[i].length; j++) {
+				f << e[i].seq[j];
+				if(j != e[i].length-1) f << ";";
+			}
+			f << '\n';
+		}
+		bool ok = f.good();
+		f.close();
+		OMNISCIO_UNTRACED_END;
+		return ok;
+	}
+
 	/**
 	 * Close the file associated with this dictionary.
 	 *
@@ -0,0 +1,54 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef OMNISCIO_EVENT_H
+#define OMNISCIO_EVENT_H
+
+#include "omniscio.h"
+
+namespace omniscio {
+
+/**
+ * The event structure describes a traced I/O operation,
+ * as stored in the operations log.
+ */
+struct event {
+	omniscio_date	start;	// date at which the operation started
+	omniscio_date	end;	// date at which the operation completed
+	int		sym;	// symbol associated with the call site
+	int		op;	// omniscio_op_type
+	int		api;	// omniscio_api_type
+	omniscio_offset	offset;
+	omniscio_size	size;
+	unsigned long	fd;	// file handle as logged by Omnisc'IO
+	int		ret;	// return status of the operation
+	const char*	name;	// file name for open operations, NULL otherwise
+};
+
+}
+
+#endif
@@ -26,6 +26,7 @@
 *******************************************************************************/
 
 #include <map>
+#include <pthread.h>
 #include "files.hpp"
 
 namespace omniscio {
@@ -39,120 +40,186 @@ static std::map<file_h,MPI_File> 	file_h_to_mpiio_fd;
 static std::map<MPI_File,file_h> 	mpiio_fd_to_file_h;
 static std::map<file_h,FILE*> 		file_h_to_libc_fd;
 static std::map<FILE*,file_h> 		libc_fd_to_file_h;
+// the files are opened and closed by all the threads
+static pthread_mutex_t			files_lock = PTHREAD_MUTEX_INITIALIZER;
 
-file_h open_posix_file(const char* filename, int fd)
+/**
+ * Finds or creates the file handle of a name, files_lock must be held.
+ */
+static file_h name_to_file_h(const char* filename)
 {
 	std::string name(filename);
-	file_h fh = 0;
-	if(filename_to_file_h.count(name)) {
-		fh = filename_to_file_h[name];
-		file_h_to_posix_fd[fh] = fd;
-		posix_fd_to_file_h[fd] = fh;
-	} else {
-		last_file_id += 1;
-		fh = last_file_id;
-		file_h_to_posix_fd[fh] = fd;
-		posix_fd_to_file_h[fd] = fh;
-		filename_to_file_h[name] = fh;
-	}
+	std::map<std::string,file_h>::iterator it 
+		= filename_to_file_h.find(name);
+	if(it != filename_to_file_h.end()) return it->second;
+	last_file_id += 1;
+	filename_to_file_h[name] = last_file_id;
+	file_h_to_filename[last_file_id] = name;
+	return last_file_id;
+}
+
+/**
+ * Finds the file handle of a key in one of the maps,
+ * files_lock must be held.
+ */
+template<typename K>
+static file_h lookup(const std::map<K,file_h>& m, const K& key)
+{
+	typename std::map<K,file_h>::const_iterator it = m.find(key);
+	return it != m.end() ? it->second : 0;
+}
+
+file_h file_from_name(const char* filename)
+{
+	pthread_mutex_lock(&files_lock);
+	file_h fh = name_to_file_h(filename);
+	pthread_mutex_unlock(&files_lock);
+	return fh;
+}
+
+file_h open_posix_file(const char* filename, int fd)
+{
+	pthread_mutex_lock(&files_lock);
+	file_h fh = name_to_file_h(filename);
+	file_h_to_posix_fd[fh] = fd;
+	posix_fd_to_file_h[fd] = fh;
+	pthread_mutex_unlock(&files_lock);
 	return fh;
 }
 
 file_h open_mpiio_file(const char* filename, MPI_File fd)
 {
-	std::string name(filename);
-	file_h fh = 0;
-	if(filename_to_file_h.count(name)) {
-		fh = filename_to_file_h[name];
-		file_h_to_mpiio_fd[fh] = fd;
-		mpiio_fd_to_file_h[fd] = fh;
-	} else {
-		last_file_id += 1;
-		fh = last_file_id;
-		file_h_to_mpiio_fd[fh] = fd;
-		mpiio_fd_to_file_h[fd] = fh;
-		filename_to_file_h[name] = fh;
-	}
+	pthread_mutex_lock(&files_lock);
+	file_h fh = name_to_file_h(filename);
+	file_h_to_mpiio_fd[fh] = fd;
+	mpiio_fd_to_file_h[fd] = fh;
+	pthread_mutex_unlock(&files_lock);
 	return fh;
 }
 
 file_h open_libc_file(const char* filename, FILE* fd)
 {
-	std::string name(filename);
-	file_h fh = 0;
-	if(filename_to_file_h.count(name)) {
-		fh = filename_to_file_h[name];
-		file_h_to_libc_fd[fh] = fd;
-		libc_fd_to_file_h[fd] = fh;
-	} else {
-		last_file_id += 1;
-		fh = last_file_id;
-		file_h_to_libc_fd[fh] = fd;
-		libc_fd_to_file_h[fd] = fh;
-		filename_to_file_h[name] = fh;
-	}
+	pthread_mutex_lock(&files_lock);
+	file_h fh = name_to_file_h(filename);
+	file_h_to_libc_fd[fh] = fd;
+	libc_fd_to_file_h[fd] = fh;
+	pthread_mutex_unlock(&files_lock);
 	return fh;
 }
 
+file_h open_file(const char* filename, const omniscio_file& f)
+{
+	switch(f.type) {
+	case OMNISCIO_POSIX:
+		return open_posix_file(filename,f.handle.posix);
+	case OMNISCIO_MPIIO:
+		return open_mpiio_file(filename,f.handle.mpiio);
+	case OMNISCIO_LIBC:
+		return open_libc_file(filename,f.handle.libc);
+	}
+	return 0;
+}
+
 void close_posix_file(int fd)
 {
+	pthread_mutex_lock(&files_lock);
 	if(posix_fd_to_file_h.count(fd)) {
 		file_h fh = posix_fd_to_file_h[fd];
 		posix_fd_to_file_h.erase(fd);
 		file_h_to_posix_fd.erase(fh);
 	}
+	pthread_mutex_unlock(&files_lock);
 }
 
 void close_mpiio_file(MPI_File fd)
 {
+	pthread_mutex_lock(&files_lock);
 	if(mpiio_fd_to_file_h.count(fd)) {
 		file_h fh = mpiio_fd_to_file_h[fd];
 		mpiio_fd_to_file_h.erase(fd);
 		file_h_to_mpiio_fd.erase(fh);
 	}
+	pthread_mutex_unlock(&files_lock);
 }
 
 void close_libc_file(FILE* fd)
 {
+	pthread_mutex_lock(&files_lock);
 	if(libc_fd_to_file_h.count(fd)) {
 		file_h fh = libc_fd_to_file_h[fd];
 		libc_fd_to_file_h.erase(fd);
 		file_h_to_libc_fd.erase(fh);
 	}
+	pthread_mutex_unlock(&files_lock);
 }
 
-const std::string& filename_from_posix_file(int fd)
+void close_file(const omniscio_file& f)
 {
-	static std::string empty;
-	if(posix_fd_to_file_h.count(fd) != 0) {
-		file_h fh = posix_fd_to_file_h[fd];
-		return file_h_to_filename[fh];
-	} else {
-		return empty;
+	switch(f.type) {
+	case OMNISCIO_POSIX:
+		close_posix_file(f.handle.posix);
+		break;
+	case OMNISCIO_MPIIO:
+		close_mpiio_file(f.handle.mpiio);
+		break;
+	case OMNISCIO_LIBC:
+		close_libc_file(f.handle.libc);
+		break;
 	}
 }
 
-const std::string& filename_from_mpiio_file(MPI_File fd)
+file_h find_file(const omniscio_file& f)
 {
-	static std::string empty;
-	if(mpiio_fd_to_file_h.count(fd) != 0) {
-		file_h fh = mpiio_fd_to_file_h[fd];
-		return file_h_to_filename[fh];
-	} else {
-		return empty;
+	file_h fh = 0;
+	pthread_mutex_lock(&files_lock);
+	switch(f.type) {
+	case OMNISCIO_POSIX:
+		fh = lookup(posix_fd_to_file_h,(int)f.handle.posix);
+		break;
+	case OMNISCIO_MPIIO:
+		fh = lookup(mpiio_fd_to_file_h,f.handle.mpiio);
+		break;
+	case OMNISCIO_LIBC:
+		fh = lookup(libc_fd_to_file_h,f.handle.libc);
+		break;
 	}
+	pthread_mutex_unlock(&files_lock);
+	return fh;
 }
 
-const std::string& filename_from_libc_file(FILE* fd)
+/**
+ * Gets the name of a file handle, files_lock must be held.
+ */
+static const std::string& file_h_name(file_h fh)
 {
 	static std::string empty;
-	if(libc_fd_to_file_h.count(fd) != 0) {
-		file_h fh = libc_fd_to_file_h[fd];
-		return file_h_to_filename[fh];
-	} else {
-		return empty;
-	}
+	std::map<file_h,std::string>::const_iterator it
+		= file_h_to_filename.find(fh);
+	return it != file_h_to_filename.end() ? it->second : empty;
 }
 
+const std::string& filename_from_posix_file(int fd)
+{
+	pthread_mutex_lock(&files_lock);
+	const std::string& name = file_h_name(lookup(posix_fd_to_file_h,fd));
+	pthread_mutex_unlock(&files_lock);
+	return name;
+}
+
+const std::string& filename_from_mpiio_file(MPI_File fd)
+{
+	pthread_mutex_lock(&files_lock);
+	const std::string& name = file_h_name(lookup(mpiio_fd_to_file_h,fd));
+	pthread_mutex_unlock(&files_lock);
+	return name;
 }
 
+const std::string& filename_from_libc_file(FILE* fd)
+{
+	pthread_mutex_lock(&files_lock);
+	const std::string& name = file_h_name(lookup(libc_fd_to_file_h,fd));
+	pthread_mutex_unlock(&files_lock);
+	return name;
+}
+
+}
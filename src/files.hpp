@@ -30,6 +30,7 @@
 
 #include <string>
 #include <mpi.h>
+#include "omniscio.h"
 
 namespace omniscio {
 
@@ -81,6 +82,36 @@ void close_mpiio_file(MPI_File fh);
  */
 void close_libc_file(FILE* fh);
 
+/**
+ * Gets the file handle of a file name, creating one if the file
+ * has never been opened.
+ * \param[in] filename : name of the file.
+ * \return Omnisc'IO file handle.
+ */
+file_h file_from_name(const char* filename);
+
+/**
+ * Create a file handle from a file name and an Omnisc'IO file
+ * of any API.
+ * \param[in] filename : name of the opened file.
+ * \param[in] f : Omnisc'IO file.
+ * \return Omnisc'IO file handle.
+ */
+file_h open_file(const char* filename, const omniscio_file& f);
+
+/**
+ * Notifies Omnisc'IO that an Omnisc'IO file of any API has been closed.
+ * \param[in] f : Omnisc'IO file.
+ */
+void close_file(const omniscio_file& f);
+
+/**
+ * Gets the file handle of an opened Omnisc'IO file of any API.
+ * \param[in] f : Omnisc'IO file.
+ * \return Omnisc'IO file handle, 0 if the file is not known.
+ */
+file_h find_file(const omniscio_file& f);
+
 /**
  * Gets the name of a file from its file descriptor.
  * \param[in] fd : posix file descriptor.
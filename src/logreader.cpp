@@ -0,0 +1,141 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <cstdlib>
+#include <sstream>
+#include "logreader.hpp"
+
+namespace omniscio {
+
+static const char* _api_name_[3] = {"POSIX","MPIIO","LIBC"};
+static const char* _op_name_[4] = {"OPEN","CLOSE","READ","WRITE"};
+
+static int find_name(const char** names, int n, const std::string& s)
+{
+	for(int i = 0; i < n; i++) {
+		if(s == names[i]) return i;
+	}
+	return -1;
+}
+
+log_reader::log_reader()
+: fmt(NONE) {}
+
+bool log_reader::open(const std::string& filename)
+{
+	fmt = NONE;
+	in.open(filename.c_str(), std::ifstream::in | std::ifstream::binary);
+	if(not in.is_open()) return false;
+
+	if(zlog_decoder::probe(in)) {
+		if(not zlog.open(in)) return false;
+		fmt = COMPRESSED;
+	} else if(binlog_reader::probe(in)) {
+		if(not binlog.open(in)) return false;
+		fmt = BINARY;
+	} else {
+		fmt = TEXT;
+	}
+	return true;
+}
+
+bool log_reader::next(event& e)
+{
+	switch(fmt) {
+	case BINARY:
+		return binlog.next(e);
+	case COMPRESSED:
+		return zlog.next(e);
+	case TEXT:
+		return next_text(e);
+	default:
+		return false;
+	}
+}
+
+/**
+ * Parses a line of the text format:
+ * "start symbol OPERATION API offset size fd return end", where offset
+ * and size are "_" for close operations, offset is "_" and size is
+ * the file name for open operations. Lines that do not parse are skipped.
+ */
+bool log_reader::next_text(event& e)
+{
+	while(std::getline(in,line)) {
+		std::istringstream ls(line);
+		std::string op, api;
+		if(not (ls >> e.start >> e.sym >> op)) continue;
+		if(op.find_first_not_of("0123456789") == std::string::npos) {
+			// older traces: "date symbol op api offset size
+			// start end fd return", all numeric
+			e.op = std::atoi(op.c_str());
+			e.name = NULL;
+			if(ls >> e.api >> e.offset >> e.size >> e.start >> e.end
+			      >> e.fd >> e.ret) return true;
+			continue;
+		}
+		if(not (ls >> api)) continue;
+		e.op = find_name(_op_name_,4,op);
+		e.api = find_name(_api_name_,3,api);
+		if(e.op < 0 || e.api < 0) continue;
+
+		// fd, return value and end are the last three fields,
+		// the file name in the middle may contain spaces
+		std::string rest;
+		std::getline(ls,rest);
+		size_t end = rest.find_last_not_of(" \r");
+		if(end == std::string::npos) continue;
+		size_t p = end+1;
+		for(int i = 0; i < 3 && p != std::string::npos && p > 0; i++) {
+			p = rest.rfind(' ',p-1);
+		}
+		if(p == std::string::npos) continue;
+		std::istringstream last(rest.substr(p));
+		if(not (last >> e.fd >> e.ret >> e.end)) continue;
+
+		std::istringstream middle(rest.substr(0,p));
+		e.offset = 0;
+		e.size = 0;
+		e.name = NULL;
+		switch(e.op) {
+		case OMNISCIO_OPEN:
+			middle >> std::ws;
+			if(middle.get() != '_' || middle.get() != ' ') continue;
+			std::getline(middle,name);
+			e.name = name.c_str();
+			break;
+		case OMNISCIO_CLOSE:
+			break;
+		default:
+			if(not (middle >> e.offset >> e.size)) continue;
+		}
+		return true;
+	}
+	return false;
+}
+
+}
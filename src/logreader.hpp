@@ -0,0 +1,94 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef OMNISCIO_LOGREADER_H
+#define OMNISCIO_LOGREADER_H
+
+#include <fstream>
+#include <string>
+#include "event.hpp"
+#include "binlog.hpp"
+#include "zlog.hpp"
+
+namespace omniscio {
+
+/**
+ * The log_reader class streams the events of an operations log written
+ * in any of the formats selected by OMNISCIO_LOG_FORMAT (binary,
+ * compressed or text). The format is found from the content of the file.
+ */
+class log_reader {
+
+	public:
+
+	enum format {
+		NONE,
+		TEXT,
+		BINARY,
+		COMPRESSED
+	};
+
+	private:
+
+	std::ifstream 		in;
+	format 			fmt;
+	binlog_reader 		binlog;
+	zlog_decoder 		zlog;
+	std::string 		line;
+	std::string 		name;
+
+	bool next_text(event& e);
+
+	public:
+
+	log_reader();
+
+	/**
+	 * Opens a log.
+	 * \param[in] filename : path of the log.
+	 * \return true in case of success, false otherwise.
+	 */
+	bool open(const std::string& filename);
+
+	/**
+	 * Returns the format of the opened log, NONE if no log is opened.
+	 */
+	format get_format() const {
+		return fmt;
+	}
+
+	/**
+	 * Reads the next event. The name field, if not NULL, remains
+	 * valid until the next call.
+	 * \return false when no more event can be read.
+	 */
+	bool next(event& e);
+};
+
+}
+
+#endif
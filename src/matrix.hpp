@@ -30,6 +30,7 @@
 
 #include <fstream>
 #include <map>
+#include <vector>
 #include "omniscio.h"
 
 namespace omniscio {
@@ -48,17 +49,17 @@ class matrix {
 
 	public:
 	
-	matrix() {}
+	matrix() : trash() {}
 
 	virtual ~matrix() {}
 
 	const T& operator()(unsigned int i, unsigned int j) const {
 		std::pair<unsigned int,unsigned int> p(i,j);
 		typename std::map<
-			std::pair<unsigned int,unsigned int>,T>::iterator it 
+			std::pair<unsigned int,unsigned int>,T>::const_iterator it 
 				= internal.find(p);
 		if(it != internal.end())
-			return internal[p];
+			return it->second;
 		else
 			return trash;
 	}
@@ -68,6 +69,24 @@ class matrix {
 		return internal[p];
 	}
 
+	/**
+	 * Renames the indices: (i,j) becomes (m[i],m[j]) (indices beyond
+	 * the end of m are left unchanged).
+	 */
+	void remap(const std::vector<int>& m) {
+		std::map<std::pair<unsigned int,unsigned int>,T> r;
+		typename std::map<
+			std::pair<unsigned int,unsigned int>,T>::iterator it;
+		for(it = internal.begin(); it != internal.end(); it++) {
+			unsigned int i = it->first.first;
+			unsigned int j = it->first.second;
+			if(i < m.size()) i = m[i];
+			if(j < m.size()) j = m[j];
+			r[std::pair<unsigned int,unsigned int>(i,j)] = it->second;
+		}
+		internal.swap(r);
+	}
+
 	bool defined(unsigned i, unsigned j) const {
 		return internal.count(
 			std::pair<unsigned int, unsigned int>(i,j)) > 0;
@@ -47,6 +47,19 @@ class model {
 
 	sequitur::oracle oracle_;
 
+	struct ignore {
+		void operator()(int) {}
+	};
+
+	// gives the same probability to all the observations
+	template<typename F>
+	struct uniform {
+		F& f;
+		double proba;
+		uniform(F& g, double p) : f(g), proba(p) {}
+		void operator()(int x) { f((T)x,proba); }
+	};
+
 	public:
 
 	model() : opened(false) { }
@@ -91,6 +104,41 @@ class model {
 		}
 	}
 
+	/**
+	 * Calls f(x,p) for each observation x predicted next, p being its
+	 * probability, without allocating any memory.
+	 * \return the number of observations predicted.
+	 */
+	template<typename F>
+	size_t for_each_prediction(F& f) {
+		ignore none;
+		size_t n = oracle_.for_each_prediction(none);
+		if(n == 0) return 0;
+		uniform<F> u(f,1.0/n);
+		oracle_.for_each_prediction(u);
+		return n;
+	}
+
+	void set_lazy(bool lazy, size_t window) {
+		oracle_.set_lazy(lazy,window);
+	}
+
+	void set_max_depth(int depth) {
+		oracle_.set_max_depth(depth);
+	}
+
+	void set_freeze(size_t window, double threshold) {
+		oracle_.set_freeze(window,threshold);
+	}
+
+	void remap(const std::vector<int>& m) {
+		oracle_.remap(m);
+	}
+
+	const sequitur::oracle::statistics& get_statistics() {
+		return oracle_.get_statistics();
+	}
+
 	~model() {
 		close();
 	}
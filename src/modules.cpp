@@ -0,0 +1,260 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <link.h>
+#include <elf.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "omniscio.h"
+#include "modules.hpp"
+
+namespace omniscio {
+
+// executable segment of a module
+struct segment {
+	uintptr_t	start;
+	uintptr_t	end;
+	uintptr_t	base;	// load address of the module
+	uint32_t	key;
+
+	bool operator<(const segment& s) const { return start < s.start; }
+};
+
+struct module {
+	uint32_t	key;
+	std::string	build_id; // hexadecimal, empty if none
+	std::string	path;
+	bool		written;
+};
+
+static std::vector<segment>	_segments_; // sorted by start address
+static std::vector<module>	_modules_;
+static unsigned long long	_adds_ = 0; // dlopen/dlclose counters
+static unsigned long long	_subs_ = 0; // at the last refresh
+static std::ofstream		_file_;
+
+static uint32_t key_of(const unsigned char* data, size_t size)
+{
+	uint32_t h = 2166136261U;
+	for(size_t i = 0; i < size; i++) {
+		h ^= data[i];
+		h *= 16777619U;
+	}
+	// 0 is reserved for unknown modules
+	return h == 0 ? 1 : h;
+}
+
+static std::string find_build_id(struct dl_phdr_info* info)
+{
+	for(int i = 0; i < info->dlpi_phnum; i++) {
+		const ElfW(Phdr)& ph = info->dlpi_phdr[i];
+		if(ph.p_type != PT_NOTE) continue;
+		const char* p = (const char*)(info->dlpi_addr + ph.p_vaddr);
+		const char* end = p + ph.p_memsz;
+		while(p + sizeof(ElfW(Nhdr)) <= end) {
+			const ElfW(Nhdr)* n = (const ElfW(Nhdr)*)p;
+			const char* name = p + sizeof(ElfW(Nhdr));
+			const unsigned char* desc = (const unsigned char*)
+				(name + ((n->n_namesz + 3) & ~3));
+			p = (const char*)desc + ((n->n_descsz + 3) & ~3);
+			if(n->n_type != NT_GNU_BUILD_ID || n->n_namesz != 4
+			|| std::memcmp(name,"GNU",4) != 0) continue;
+			std::stringstream ss;
+			ss << std::hex << std::setfill('0');
+			for(size_t j = 0; j < n->n_descsz; j++)
+				ss << std::setw(2) << (int)desc[j];
+			return ss.str();
+		}
+	}
+	return std::string();
+}
+
+static std::string executable_path()
+{
+	char buf[4096];
+	ssize_t s = readlink("/proc/self/exe",buf,sizeof(buf)-1);
+	if(s <= 0) return std::string();
+	return std::string(buf,s);
+}
+
+static int add_module(struct dl_phdr_info* info, size_t size, void* data)
+{
+	if(size >= offsetof(struct dl_phdr_info,dlpi_subs)
+			+ sizeof(info->dlpi_subs)) {
+		_adds_ = info->dlpi_adds;
+		_subs_ = info->dlpi_subs;
+	}
+
+	module m;
+	m.path = info->dlpi_name ? info->dlpi_name : "";
+	if(m.path.empty()) m.path = executable_path();
+	m.build_id = find_build_id(info);
+	if(m.build_id.empty()) {
+		m.key = key_of((const unsigned char*)m.path.c_str(),
+				m.path.size());
+	} else {
+		m.key = key_of((const unsigned char*)m.build_id.c_str(),
+				m.build_id.size());
+	}
+	m.written = false;
+
+	std::vector<segment>& segments = *(std::vector<segment>*)data;
+	for(int i = 0; i < info->dlpi_phnum; i++) {
+		const ElfW(Phdr)& ph = info->dlpi_phdr[i];
+		if(ph.p_type != PT_LOAD || (ph.p_flags & PF_X) == 0) continue;
+		segment s;
+		s.start = info->dlpi_addr + ph.p_vaddr;
+		s.end = s.start + ph.p_memsz;
+		s.base = info->dlpi_addr;
+		s.key = m.key;
+		segments.push_back(s);
+	}
+
+	for(size_t i = 0; i < _modules_.size(); i++) {
+		if(_modules_[i].key == m.key && _modules_[i].path == m.path)
+			return 0;
+	}
+	_modules_.push_back(m);
+	return 0;
+}
+
+static void describe(std::ostream& os, const module& m)
+{
+	os << std::hex << std::setw(8) << std::setfill('0') 
+	   << m.key << std::dec << ' '
+	   << (m.build_id.empty() ? "-" : m.build_id) << ' '
+	   << m.path << '\n';
+}
+
+static void write_modules()
+{
+	if(not _file_.is_open()) return;
+	OMNISCIO_UNTRACED_START;
+	for(size_t i = 0; i < _modules_.size(); i++) {
+		module& m = _modules_[i];
+		if(m.written) continue;
+		describe(_file_,m);
+		m.written = true;
+	}
+	_file_.flush();
+	OMNISCIO_UNTRACED_END;
+}
+
+static void build_table()
+{
+	std::vector<segment> segments;
+	dl_iterate_phdr(add_module,&segments);
+	std::sort(segments.begin(),segments.end());
+	_segments_.swap(segments);
+	write_modules();
+}
+
+static int read_counters(struct dl_phdr_info* info, size_t size, void* data)
+{
+	unsigned long long* c = (unsigned long long*)data;
+	if(size >= offsetof(struct dl_phdr_info,dlpi_subs)
+			+ sizeof(info->dlpi_subs)) {
+		c[0] = info->dlpi_adds;
+		c[1] = info->dlpi_subs;
+	}
+	return 1;
+}
+
+bool open_modules(const std::string& filename)
+{
+	if(not filename.empty()) {
+		OMNISCIO_UNTRACED_START;
+		_file_.open(filename.c_str());
+		OMNISCIO_UNTRACED_END;
+	}
+	build_table();
+	return filename.empty() || _file_.good();
+}
+
+std::string describe_modules()
+{
+	std::stringstream ss;
+	for(size_t i = 0; i < _modules_.size(); i++)
+		describe(ss,_modules_[i]);
+	return ss.str();
+}
+
+void close_modules()
+{
+	OMNISCIO_UNTRACED_START;
+	_file_.close();
+	OMNISCIO_UNTRACED_END;
+}
+
+bool refresh_modules()
+{
+	unsigned long long c[2] = { _adds_, _subs_ };
+	dl_iterate_phdr(read_counters,c);
+	if(c[0] == _adds_ && c[1] == _subs_ && not _segments_.empty())
+		return false;
+	build_table();
+	return true;
+}
+
+static const segment* find_segment(uintptr_t addr)
+{
+	// last segment starting before addr; a return address may
+	// be right after the end of its segment
+	segment s;
+	s.start = addr;
+	std::vector<segment>::const_iterator it =
+		std::lower_bound(_segments_.begin(),_segments_.end(),s);
+	if(it == _segments_.begin()) return NULL;
+	--it;
+	if(addr > it->end) return NULL;
+	return &(*it);
+}
+
+void normalize_frames(void** frames, size_t n)
+{
+	for(size_t i = 0; i < n; i++) {
+		uintptr_t a = (uintptr_t)frames[i];
+		const segment* s = find_segment(a);
+		if(s == NULL && refresh_modules()) s = find_segment(a);
+		uint64_t f;
+		if(s == NULL) {
+			f = (uint32_t)a;
+		} else {
+			f = ((uint64_t)s->key << 32) | (uint32_t)(a - s->base);
+		}
+		frames[i] = (void*)(uintptr_t)f;
+	}
+}
+
+}
@@ -0,0 +1,87 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+
+#ifndef OMNISCIO_MODULES_H
+#define OMNISCIO_MODULES_H
+
+#include <cstddef>
+#include <string>
+
+namespace omniscio {
+
+/**
+ * Return addresses change from one run (or one rank) to another when
+ * the executable or the libraries are loaded at random addresses, so
+ * frames are stored as (module key << 32 | offset in the module). The
+ * key is derived from the build-id of the module (or from its path if
+ * it has none) and the offset is relative to the load address of the
+ * module, as expected by addr2line. A frame that does not belong to
+ * any known module gets the key 0 and keeps the low 32 bits of its
+ * address.
+ */
+
+/**
+ * Builds the table of the loaded modules and records them in a file,
+ * one line "key build-id path" per module.
+ * \param[in] filename : name of the file (<prefix>modules), empty
+ * to keep the table in memory only.
+ * \return true in case of success, false otherwise.
+ */
+bool open_modules(const std::string& filename);
+
+/**
+ * Describes all the modules seen so far, in the format of the file
+ * written by open_modules.
+ */
+std::string describe_modules();
+
+/**
+ * Closes the file in which the modules are recorded.
+ */
+void close_modules();
+
+/**
+ * Looks again for loaded modules if libraries have been loaded or
+ * unloaded (dlopen/dlclose) since the table was built.
+ * \return true if the table changed.
+ */
+bool refresh_modules();
+
+/**
+ * Replaces each return address by its (key, offset) form. Addresses
+ * that are not found trigger a refresh of the table, otherwise no
+ * memory is allocated.
+ * \param[in,out] frames : return addresses.
+ * \param[in] n : number of return addresses.
+ */
+void normalize_frames(void** frames, size_t n);
+
+}
+
+#endif
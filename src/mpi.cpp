@@ -32,8 +32,6 @@
 
 extern "C" {
 
-extern int omniscio_tracing_enabled;
-
 int MPI_Init(int* argc, char*** argv) {
 	int ret = PMPI_Init(argc,argv);
 	omniscio_init(argc,argv);
@@ -59,69 +57,62 @@ int MPI_Send(const void *buf, int count,
 		MPI_Datatype datatype, int dest, int tag,
 		MPI_Comm comm)
 {
-	int old = omniscio_tracing_enabled;
-	omniscio_tracing_enabled = 0;
+	OMNISCIO_UNTRACED_START;
 	int err = PMPI_Send(buf,count,datatype,dest,tag,comm);
-	omniscio_tracing_enabled = old;
+	OMNISCIO_UNTRACED_END;
 	return err;
 }
 
 int MPI_Irecv(void *buf, int count, MPI_Datatype datatype, int source,
               int tag, MPI_Comm comm, MPI_Request *request)
 {
-	int old = omniscio_tracing_enabled;
-	omniscio_tracing_enabled = 0;
+	OMNISCIO_UNTRACED_START;
 	int err = PMPI_Irecv(buf,count,datatype,source,tag,comm,request);
-	omniscio_tracing_enabled = old;
+	OMNISCIO_UNTRACED_END;
 	return err;
 }
 
 int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype,
     int root, MPI_Comm comm) 
 {
-	int old = omniscio_tracing_enabled;
-	omniscio_tracing_enabled = 0;
+	OMNISCIO_UNTRACED_START;
 	int err = PMPI_Bcast(buffer,count,datatype,root,comm);
-	omniscio_tracing_enabled = old;
+	OMNISCIO_UNTRACED_END;
 	return err;
 }
 
 void mpi_bcast_(void *buffer, MPI_Fint* count, MPI_Fint* datatype,
 		MPI_Fint* root, MPI_Fint* comm, MPI_Fint* err) 
 {
-	int old = omniscio_tracing_enabled;
-	omniscio_tracing_enabled = 0;
+	OMNISCIO_UNTRACED_START;
 	*err = PMPI_Bcast(buffer,*count,MPI_Type_f2c(*datatype),*root,MPI_Comm_f2c(*comm));
-	omniscio_tracing_enabled = old;
+	OMNISCIO_UNTRACED_END;
 }
 
 int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count,
     MPI_Datatype datatype, MPI_Op op, MPI_Comm comm) 
 {
-	int old = omniscio_tracing_enabled;
-	omniscio_tracing_enabled = 0;
+	OMNISCIO_UNTRACED_START;
 	int err = PMPI_Allreduce(sendbuf,recvbuf,count,datatype,op,comm);
-	omniscio_tracing_enabled = old;
+	OMNISCIO_UNTRACED_END;
 	return err;
 }
 
 int MPI_Waitall(int count, MPI_Request *array_of_requests,
     MPI_Status *array_of_statuses)
 {
-	int old = omniscio_tracing_enabled;
-	omniscio_tracing_enabled = 0;
+	OMNISCIO_UNTRACED_START;
 	int err = PMPI_Waitall(count,array_of_requests,array_of_statuses);
-	omniscio_tracing_enabled = old;
+	OMNISCIO_UNTRACED_END;
 	return err;
 }
 
 int MPI_Waitany(int count, MPI_Request *array_of_requests,
     int *index, MPI_Status *status)
 {
-	int old = omniscio_tracing_enabled;
-	omniscio_tracing_enabled = 0;
+	OMNISCIO_UNTRACED_START;
 	int err = PMPI_Waitany(count,array_of_requests,index,status);
-	omniscio_tracing_enabled = old;
+	OMNISCIO_UNTRACED_END;
 	return err;
 }
 
@@ -135,24 +126,22 @@ void mpi_waitany_(MPI_Fint* count, MPI_Fint* array_of_requests,
 	for(i=0;i<*count;i++) {
 		c_req[i] = MPI_Request_f2c(array_of_requests[i]);
 	}
-	int old = omniscio_tracing_enabled;
-        omniscio_tracing_enabled = 0;
+	OMNISCIO_UNTRACED_START;
 	*err = PMPI_Waitany(*count,c_req,index,&cstatus);
 	*index += 1;
 	MPI_Status_c2f(&cstatus, status);
 	for(i=0;i<*count;i++) {
 		array_of_requests[i] = MPI_Request_c2f(c_req[i]);
 	}
-	omniscio_tracing_enabled = old;
+	OMNISCIO_UNTRACED_END;
 	free(c_req);
 }
 
 int MPI_Wait(MPI_Request *request, MPI_Status *status)
 {
-	int old = omniscio_tracing_enabled;
-	omniscio_tracing_enabled = 0;
+	OMNISCIO_UNTRACED_START;
 	int err = PMPI_Wait(request,status);
-	omniscio_tracing_enabled = old;
+	OMNISCIO_UNTRACED_END;
 	return err;
 }
 
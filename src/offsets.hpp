@@ -43,6 +43,7 @@ class offset_op {
 	
 	offset_op() {
 		type_ = FOLLOWING;   
+		offset_ = 0;
 	}
 	
 	offset_op(off_t s, type t = ABSOLUTE) {   
@@ -173,14 +174,21 @@ class offset_tracker {
 			return occurences;
 		}
 
+		// remembers the last predicted symbol
+		struct last_symbol {
+			int sym;
+			last_symbol() : sym(0) {}
+			void operator()(int s) { sym = s; }
+		};
+
 		virtual offset_op predict() {
-			std::set<int> pred = o.predict_next();
-			if(pred.size() == 1) {
-				int sym = *pred.begin();
-				return symbols_offset[sym];
-			} else {
-				return last_off;
+			last_symbol p;
+			if(o.for_each_prediction(p) == 1) {
+				std::map<int,offset_op>::const_iterator it
+					= symbols_offset.find(p.sym);
+				if(it != symbols_offset.end()) return it->second;
 			}
+			return last_off;
                 }
 
 		virtual void input(offset_op op) {
@@ -303,7 +311,7 @@ class offset_tracker {
 		}
 	}
 
-	offset_op predict() {
+	offset_op predict() const {
 		if(st) return st->predict();
 		else return offset_op();
 	}
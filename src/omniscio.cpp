@@ -25,13 +25,17 @@
  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 *******************************************************************************/
 
-#include <execinfo.h>
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <cmath>
+#include <map>
 #include <sstream>
 #include <iomanip>
+#include <pthread.h>
+#include <signal.h>
 #include <mpi.h>
 
 #include "trace.hpp"
@@ -42,13 +46,35 @@
 #include "sizes.hpp"
 #include "offsets.hpp"
 #include "stats/adaptive_stats.hpp"
+#include "stats/histogram.hpp"
+#include "event.hpp"
+#include "zlog.hpp"
+#include "binlog.hpp"
 #include "log.hpp"
+#include "writer.hpp"
+#include "ring.hpp"
+#include "clock.hpp"
+#include "files.hpp"
 #include "omniscio.h"
 
 extern "C" {
 	int omniscio_tracing_enabled = 0;
+	__thread int omniscio_untraced = 0;
+
+	int* omniscio_untraced_flag(void) {
+		return &omniscio_untraced;
+	}
+
+	// bounds of the section of the entry points, set by the linker
+	extern char __start_omniscio_entry[];
+	extern char __stop_omniscio_entry[];
 }
 
+// the functions between the application and the capture of its stack
+// are kept in their own section, so that their frames are recognized
+// whatever the compiler inlined
+#define ENTRY_POINT	__attribute__((section("omniscio_entry")))
+
 typedef int omniscio_symbol;
 
 namespace omniscio {
@@ -56,24 +82,287 @@ namespace omniscio {
 static dictionary<omniscio_addr,omniscio_symbol> _dictionary_;
 static model<omniscio_symbol> 			_model_;
 
+#define FREEZE_WINDOW		1000
+#define FREEZE_THRESHOLD	0.99
+
 static matrix<adaptive_stats<double> > 		_time_table_;
 static vector<size_tracker> 			_size_table_;
 static matrix<offset_tracker> 			_offset_table_;
 static vector<omniscio_op_type>			_type_table_;
 
-static logstream<std::ofstream> 		_predictions_;
-static logstream<std::ofstream> 		_operations_;
+static logstream<log_file> 			_predictions_;
+static logstream<log_file> 			_operations_;
+static zlog_encoder				_zlog_;
+static binlog_writer				_binlog_;
 
 static bool 					_enabled_ = false;
-static bool 					_started_ = false;
+static bool					_dump_stats_ = false;
+
+#define PROFILE_STAGES	(OMNISCIO_STAGE_TOTAL+1)
+
+static bool					_profile_ = false;
+// model and trackers stages by operation type, under _model_lock_
+static histogram				_learn_profile_[4][2];
+
+#define OVERHEAD_WINDOW		0.01	// s between two decisions
+#define OVERHEAD_DECAY		0.1	// s for the past to weigh 1/e
+#define LEVEL_FULL		0
+#define LEVEL_HOT_SITES		1	// call site cache even if disabled
+#define LEVEL_PAUSED		6	// levels between learn 1 op in 2, 4...
+
+// fraction of the time a thread may spend in Omnisc'IO, 0 if unbounded
+static double					_max_overhead_ = 0.0;
 
-static omniscio_date				_current_date_ = 0.0;
-static omniscio_date				_previous_date_ = 0.0;
+enum log_format {
+	LOG_TEXT,
+	LOG_BINARY,
+	LOG_COMPRESSED
+};
+
+static log_format				_log_format_ = LOG_BINARY;
+static std::string				_prefix_;
+static std::string				_base_; // prefix without rank
+static bool					_unify_ = false;
+
+// last operation fed to the model
 static omniscio_symbol 				_previous_sym_ = 0;
-static omniscio_size 				_previous_size_ = 0;
-static omniscio_offset 				_previous_offset_ = 0;
+
+// last operation on a file (see files.hpp), the offsets are
+// predicted from the previous operation on the same file
+struct file_state {
+	omniscio_symbol	sym;
+	omniscio_offset	offset;
+	omniscio_size	size;
+	omniscio_file	handle;		// last handle used to access the file
+};
+
+static std::map<file_h,file_state>		_files_;
+// file of the last operation of each symbol
+static vector<file_h>				_symbol_files_;
+
+#define MAX_STACK_DEPTH	OMNISCIO_MAX_FRAMES
+#define DEPTH_MARGIN	4
+#define SKIP_SLACK	8	// frames of Omnisc'IO and of the wrappers
+
+static size_t					_stack_depth_ = MAX_STACK_DEPTH;
+static bool					_adaptive_depth_ = false;
+static std::vector<std::vector<omniscio_addr> >	_margins_;
+static std::vector<bool>			_margin_known_;
+// protects the dictionary, the modules, the depth and the margins
+static pthread_mutex_t				_symbol_lock_ = 
+						PTHREAD_MUTEX_INITIALIZER;
+
+#define CALLSITE_CACHE_SIZE	1024
+#define CALLSITE_MAX_KEY	8
+#define CALLSITE_CHECKS		4
+
+// entry of the call site cache, see current_symbol
+struct callsite {
+	omniscio_addr	key[CALLSITE_MAX_KEY]; // innermost return addresses
+	omniscio_symbol	sym;		// 0 if the entry is free
+	int		checks;		// full lookups that agreed with sym
+	bool		ambiguous;	// full lookups disagreed
+};
+
+#define CALLSITE_KEY		3
+
+static size_t					_callsite_key_ = CALLSITE_KEY;
+// changes when the call sites may get other symbols
+static unsigned long				_callsite_generation_ = 0;
+
+// operation handed over to the consumer thread in asynchronous mode
+struct update {
+	omniscio_symbol	sym;
+	int		op;		// omniscio_op_type
+	omniscio_offset	offset;
+	omniscio_size	size;
+	omniscio_date	interval;	// since the end of the previous operation
+	file_h		file;		// 0 if the file is not known
+	omniscio_file	handle;
+};
+
+// update that only drops the state of a closed file
+#define FORGET_FILE	-1
+
+/**
+ * State of a thread doing I/O. Each thread has its own operation in
+ * progress, call site cache and, in asynchronous mode, queue of
+ * operations. The model and the tables are shared by all the threads.
+ */
+struct thread_state {
+	bool		started;	// an operation is in progress
+	omniscio_date	current_date;	// start of the operation in progress
+	omniscio_date	previous_date;	// end of the previous one, 0 if none
+	event		ev;		// operation in progress
+	file_h		file;		// file of the operation in progress
+	omniscio_file	handle;
+	callsite	callsites[CALLSITE_CACHE_SIZE];
+	unsigned long	generation;	// _callsite_generation_ of callsites
+	long		callsite_hits;
+	long		callsite_misses;
+	ring<update>	updates;	// read by the consumer thread
+	long		async_drops;
+	long		async_backlog;
+	histogram*	profile;	// [op*PROFILE_STAGES+stage] if profiling
+	long long	spent[PROFILE_STAGES]; // ns, -1 for the skipped stages
+	int		level;		// degradation, see control_overhead
+	omniscio_date	window_start;	// of the overhead measurement
+	omniscio_date	window_spent;	// in Omnisc'IO since window_start
+	double		overhead;	// estimated before window_start
+	unsigned long	sampled;	// operations seen since degraded
+	long		overhead_skipped;
+	long		overhead_level;
+
+	thread_state()
+	: started(false), current_date(0.0), previous_date(0.0),
+	  file(0), generation(0), callsite_hits(0), callsite_misses(0),
+	  async_drops(0), async_backlog(0), profile(NULL), level(LEVEL_FULL),
+	  window_start(0.0), window_spent(0.0), overhead(0.0), sampled(0),
+	  overhead_skipped(0), overhead_level(LEVEL_FULL) {
+		std::memset(&ev,0,sizeof(ev));
+		std::memset(&handle,0,sizeof(handle));
+		std::memset(callsites,0,sizeof(callsites));
+		std::fill(spent,spent+PROFILE_STAGES,-1LL);
+	}
+};
+
+static __thread thread_state*			_thread_ = NULL;
+// states of the threads doing I/O, retired when they exit
+static std::vector<thread_state*>		_threads_;
+static pthread_key_t				_thread_key_;
+static pthread_once_t				_thread_key_once_ = 
+						PTHREAD_ONCE_INIT;
+// counters of the threads that exited, one of _threads_
+static thread_state*				_retired_ = NULL;
+static pthread_mutex_t				_threads_lock_ = 
+						PTHREAD_MUTEX_INITIALIZER;
+
+#define ASYNC_CAPACITY	4096
+#define ASYNC_SLEEP_NS	50000
+
+static bool					_async_ = false;
+static size_t					_async_capacity_ = 0;
+static pthread_t				_consumer_;
+static int					_stop_ = 0;
+// protects the model, the tables and _previous_*, held by the consumer
+// thread while it updates them (taken after _threads_lock_)
+static pthread_mutex_t				_model_lock_ = 
+						PTHREAD_MUTEX_INITIALIZER;
+// protects _published_, the predictions after the last update
+static pthread_mutex_t				_published_lock_ = 
+						PTHREAD_MUTEX_INITIALIZER;
+static std::vector<omniscio_req>		_published_;
+static int					_publish_ = 0;
+// protects the operations log
+static pthread_mutex_t				_log_lock_ = 
+						PTHREAD_MUTEX_INITIALIZER;
+
+static void* consume(void*);
+
+/**
+ * Converts a duration into ns.
+ */
+static inline long long to_ns(omniscio_date d)
+{
+	return (long long)(d*1e9);
+}
+
+/**
+ * Charges time to a stage of the operation in progress of a thread.
+ */
+static inline void charge(thread_state* ts, int stage, long long ns)
+{
+	if(ts->spent[stage] < 0) ts->spent[stage] = 0;
+	ts->spent[stage] += ns;
+}
+
+/**
+ * Counts the time spent in each stage of the operation that just ended
+ * in the histograms of the thread.
+ */
+static void count_stages(thread_state* ts)
+{
+	histogram* h = ts->profile + ts->ev.op*PROFILE_STAGES;
+	for(int s = 0; s < PROFILE_STAGES; s++) {
+		if(ts->spent[s] >= 0) h[s].add(ts->spent[s]);
+		ts->spent[s] = -1;
+	}
+}
+
+/**
+ * Adapts the degradation level of a thread to the fraction of its time
+ * spent in Omnisc'IO. The fraction is measured over windows of at least
+ * OVERHEAD_WINDOW seconds and averaged with the previous ones, which
+ * weigh less the longer the window: a slow operation does not make a
+ * window over budget on its own, and an idle thread gets back under
+ * budget whatever came before. Over _max_overhead_, the level goes up
+ * by one: the call site cache is used even if it was disabled
+ * (LEVEL_HOT_SITES), then only 1 operation in 2, 4, 8 and 16 is learned,
+ * then none (LEVEL_PAUSED). Under half of _max_overhead_, it goes down
+ * by one.
+ * \param[in] ts : state of the calling thread.
+ * \param[in] date : end of the call.
+ * \param[in] spent : duration of the call.
+ */
+static void control_overhead(thread_state* ts, omniscio_date date,
+		omniscio_date spent)
+{
+	ts->window_spent += spent;
+	if(ts->window_start == 0.0) ts->window_start = date - spent;
+	omniscio_date window = date - ts->window_start;
+	if(window < OVERHEAD_WINDOW) return;
+
+	double past = std::exp(-window/OVERHEAD_DECAY);
+	ts->overhead = past*ts->overhead + (1.0-past)*ts->window_spent/window;
+	if(ts->overhead > _max_overhead_ && ts->level < LEVEL_PAUSED) {
+		ts->level += 1;
+		ts->sampled = 0;
+		if(ts->level > ts->overhead_level) 
+			ts->overhead_level = ts->level;
+	} else if(ts->overhead < _max_overhead_/2 
+		&& ts->level > LEVEL_FULL) {
+		ts->level -= 1;
+		ts->sampled = 0;
+	}
+	ts->window_start = date;
+	ts->window_spent = 0.0;
+}
+
+/**
+ * Measures the time spent in a call of the tracing API by the calling
+ * thread, when profiling (OMNISCIO_PROFILE) or bounding the overhead
+ * (OMNISCIO_MAX_OVERHEAD). The stages of an operation are counted once
+ * its end is traced.
+ */
+class profiled {
+
+	private:
+
+	bool		measured;
+	omniscio_date	entered;
+	bool		ends;
+
+	public:
+
+	profiled(bool e) 
+	: measured(_profile_ || _max_overhead_ > 0.0),
+	  entered(measured ? now() : 0.0), ends(e) {}
+
+	~profiled() {
+		thread_state* ts = _thread_;
+		if(not measured || not _enabled_ || ts == NULL) return;
+		omniscio_date exited = now();
+		if(ts->profile != NULL) {
+			charge(ts,OMNISCIO_STAGE_TOTAL,to_ns(exited-entered));
+			if(ends) count_stages(ts);
+		}
+		if(_max_overhead_ > 0.0)
+			control_overhead(ts,exited,exited-entered);
+	}
+};
 
 static const char* _api_name_[3] = {"POSIX","MPIIO","LIBC"};
+static const char* _op_name_[4] = {"OPEN","CLOSE","READ","WRITE"};
 
 int init(int* /*argc*/, char*** /*argv*/)
 {
@@ -85,6 +374,43 @@ int init(int* /*argc*/, char*** /*argv*/)
 		return OMNISCIO_OK;
 	}
 
+	// OMNISCIO_UNWINDER=glibc|fp|libunwind selects how stacks
+	// are captured (see unwind.hpp), glibc by default.
+	unwinder u = find_unwinder(std::getenv("OMNISCIO_UNWINDER"));
+	if(u != NULL) unwind = u;
+
+	// OMNISCIO_CLOCK=mpi|raw|coarse|tsc selects how the operations
+	// are dated (see clock.hpp), MPI_Wtime by default.
+	clock_reader c = find_clock(std::getenv("OMNISCIO_CLOCK"));
+	if(c != NULL) now = c;
+	// the first capture may allocate (glibc's backtrace loads libgcc,
+	// the frame pointer unwinder looks up the stack bounds), later
+	// ones do not, which makes them safe in signal handlers
+	trace warmup(1);
+
+	// OMNISCIO_CALLSITE_CACHE=<k> identifies call sites by the k
+	// innermost return addresses of the application before unwinding
+	// the whole stack (3 by default, 0 disables the cache).
+	char* cc = std::getenv("OMNISCIO_CALLSITE_CACHE");
+	if(cc != NULL) {
+		_callsite_key_ = std::min(std::max(std::atoi(cc),0),
+					CALLSITE_MAX_KEY);
+	}
+
+	// OMNISCIO_STACK_DEPTH=<n> keeps the n innermost frames of each
+	// call stack, OMNISCIO_STACK_DEPTH=adaptive finds the smallest depth
+	// that still distinguishes the call sites (256 frames by default).
+	char* sd = std::getenv("OMNISCIO_STACK_DEPTH");
+	if(sd != NULL) {
+		if(std::string(sd) == "adaptive") {
+			_adaptive_depth_ = true;
+			_stack_depth_ = 1;
+		} else if(std::atoi(sd) > 0) {
+			_stack_depth_ = std::min(std::atoi(sd),MAX_STACK_DEPTH);
+		}
+	}
+	trace::skip_module("libomniscio-posix");
+
 	std::string wdir(".");
 	char* w = std::getenv("OMNISCIO_DIRECTORY");
 	if(w != NULL) wdir = std::string(w);
@@ -101,140 +427,706 @@ int init(int* /*argc*/, char*** /*argv*/)
 	   << std::setw(log10((double)size)+1) 
 	   << std::setfill('0') << rank << ".";
 
-	_dictionary_.open(ss.str()+"dict");
+	std::stringstream bs;
+	bs << wdir << "/omniscio." << t << ".";
+	_base_ = bs.str();
+
+	// OMNISCIO_WRITER[=<KiB>] leaves the writes of the log files to a
+	// background thread, through two buffers of 1 MiB by default per
+	// file (see writer.hpp). Records are handed over to the thread at
+	// least every OMNISCIO_WRITER_INTERVAL ms (1000 by default). When
+	// the file system is late, they are dropped, or waited for if
+	// OMNISCIO_WRITER_BLOCK is set.
+	char* wr = std::getenv("OMNISCIO_WRITER");
+	if(wr != NULL) {
+		long kib = std::atol(wr);
+		if(kib <= 0) kib = 1024;
+		char* wi = std::getenv("OMNISCIO_WRITER_INTERVAL");
+		long interval = wi == NULL ? 1000 : std::atol(wi);
+		start_writer(kib*1024,interval,
+			std::getenv("OMNISCIO_WRITER_BLOCK") == NULL);
+	}
+
+	// OMNISCIO_UNIFY gives the same symbols to the same call stacks on
+	// all the ranks at finalize (see unify), the dictionary and the
+	// modules are then written once for all the ranks.
+	_unify_ = (std::getenv("OMNISCIO_UNIFY") != NULL);
+
+	if(not _unify_) _dictionary_.open(ss.str()+"dict");
+	// OMNISCIO_LOAD_PREFIX=<prefix> gives back to the call stacks the
+	// symbols of a previous run, saved in <prefix><rank>.bdict (the
+	// prefix of that run without the rank) or in <prefix>bdict.
+	char* lp = std::getenv("OMNISCIO_LOAD_PREFIX");
+	if(lp != NULL) {
+		std::stringstream ls;
+		ls << lp << std::setw(log10((double)size)+1)
+		   << std::setfill('0') << rank << ".bdict";
+		if(not _dictionary_.load(ls.str()))
+			_dictionary_.load(std::string(lp)+"bdict");
+	}
+
+	// the dictionary refers to the modules by key,
+	// omniscio-symbolize needs this file to resolve them
+	open_modules(_unify_ ? std::string() : ss.str()+"modules");
 	_model_.open(ss.str()+"model");
 //	_time_table_.open(ss.str()+"time");
 //	_size_table_.open(ss.str()+"size");
 //	_offset_table_.open(ss.str()+"offset");
 //	_type_table_.open(ss.str()+"type");
 	_predictions_.open(ss.str()+"pred");
-	_operations_.open(ss.str()+"log");
+
+	// OMNISCIO_LOG_FORMAT=binary|compressed|text selects how the
+	// operations are stored: fixed-width records (see binlog.hpp, the
+	// default), a grammar and residuals (see zlog.hpp) or text lines.
+	// log_reader reads all of them. A compressed log is written by
+	// chunks of 4096 operations: a process that does not finalize
+	// loses those of its last chunk.
+	char* f = std::getenv("OMNISCIO_LOG_FORMAT");
+	_log_format_ = LOG_BINARY;
+	if(f != NULL && std::string(f) == "compressed")
+		_log_format_ = LOG_COMPRESSED;
+	if(f != NULL && std::string(f) == "text")
+		_log_format_ = LOG_TEXT;
+	// a compressed record depends on the previous ones
+	_operations_.get_stream().set_blocking(_log_format_ == LOG_COMPRESSED);
+	if(_log_format_ == LOG_COMPRESSED) {
+		_operations_.open(ss.str()+"zlog",
+			std::ios_base::out | std::ios_base::binary);
+		OMNISCIO_UNTRACED_START;
+		_zlog_.open(_operations_.get_stream());
+		OMNISCIO_UNTRACED_END;
+	} else if(_log_format_ == LOG_BINARY) {
+		_operations_.open(ss.str()+"log",
+			std::ios_base::out | std::ios_base::binary);
+		OMNISCIO_UNTRACED_START;
+		_binlog_.open(_operations_.get_stream());
+		OMNISCIO_UNTRACED_END;
+	} else {
+		_operations_.open(ss.str()+"log");
+	}
+
+	// OMNISCIO_LAZY=<n> only rebuilds the predictors when a
+	// prediction is requested, replaying the last n operations. The
+	// predictions only have the context of those n operations, they
+	// may include more symbols than without it (see set_lazy).
+	char* l = std::getenv("OMNISCIO_LAZY");
+	if(l != NULL) {
+		int window = std::atoi(l);
+		if(window <= 0) window = 32;
+		_model_.set_lazy(true,window);
+	}
+
+	// OMNISCIO_MAX_DEPTH=<n> bounds the depth of the grammar.
+	char* d = std::getenv("OMNISCIO_MAX_DEPTH");
+	if(d != NULL) {
+		_model_.set_max_depth(std::atoi(d));
+	}
+
+	_prefix_ = ss.str();
+	_dump_stats_ = (std::getenv("OMNISCIO_STATS") != NULL);
+	// OMNISCIO_PROFILE measures the time spent in each stage of the
+	// operations (see omniscio_get_profile), written in a .profile file.
+	_profile_ = (std::getenv("OMNISCIO_PROFILE") != NULL);
+
+	// OMNISCIO_MAX_OVERHEAD=<percent> bounds the fraction of its time
+	// a thread spends in Omnisc'IO, by learning less of its operations
+	// when over budget (see control_overhead). The operations are
+	// still logged.
+	char* mo = std::getenv("OMNISCIO_MAX_OVERHEAD");
+	_max_overhead_ = 0.0;
+	if(mo != NULL && std::atof(mo) > 0.0) {
+		_max_overhead_ = std::atof(mo)/100.0;
+		_dump_stats_ = true;
+	}
+
+	// OMNISCIO_FREEZE[=<n>] stops learning once the last n operations
+	// (1000 by default) were predicted, and learns again when they no
+	// longer are. OMNISCIO_FREEZE_THRESHOLD=<percent> (99 by default)
+	// tolerates some mispredictions. The time spent in each mode is
+	// reported in the statistics.
+	char* fz = std::getenv("OMNISCIO_FREEZE");
+	if(fz != NULL) {
+		int window = std::atoi(fz);
+		if(window <= 0) window = FREEZE_WINDOW;
+		double threshold = FREEZE_THRESHOLD;
+		char* ft = std::getenv("OMNISCIO_FREEZE_THRESHOLD");
+		if(ft != NULL) threshold = std::atof(ft)/100.0;
+		_model_.set_freeze(window,threshold);
+		_dump_stats_ = true;
+	}
+
+	// OMNISCIO_ASYNC[=<capacity>] leaves the model and the tables to a
+	// background thread, the I/O calls only find the symbol and queue
+	// the operation (see consume). Operations that do not fit in the
+	// queue (4096 by default) are dropped.
+	char* a = std::getenv("OMNISCIO_ASYNC");
+	if(a != NULL) {
+		int capacity = std::atoi(a);
+		if(capacity <= 1) capacity = ASYNC_CAPACITY;
+		_async_capacity_ = capacity;
+		pthread_mutex_lock(&_threads_lock_);
+		for(size_t i = 0; i < _threads_.size(); i++)
+			_threads_[i]->updates.reserve(capacity);
+		pthread_mutex_unlock(&_threads_lock_);
+		_stop_ = 0;
+		// signals are left to the application threads
+		sigset_t all, old;
+		sigfillset(&all);
+		pthread_sigmask(SIG_SETMASK,&all,&old);
+		_async_ = (pthread_create(&_consumer_,NULL,consume,NULL) == 0);
+		pthread_sigmask(SIG_SETMASK,&old,NULL);
+	}
 
 	return OMNISCIO_OK;
 }
 
-void update_offset(omniscio_offset current, omniscio_symbol sym) 
+/**
+ * Converts a captured stack into a symbol. Only the _stack_depth_
+ * innermost frames are kept. In adaptive mode, the next DEPTH_MARGIN
+ * frames are remembered for each symbol; when a known symbol shows up
+ * with different frames there, two call sites were merged and the
+ * depth is raised past the first difference, so that the depth
+ * settles on the shortest one telling apart the call sites seen so far.
+ * \param[in] t : stack, captured with at least DEPTH_MARGIN frames
+ * more than _stack_depth_ in adaptive mode. _symbol_lock_ must be held.
+ * \return the symbol.
+ */
+static omniscio_symbol stack_symbol(trace& t)
+{
+	size_t captured = t.size();
+
+	if(not _adaptive_depth_) {
+		t.resize(_stack_depth_);
+		return _dictionary_.insert(t);
+	}
+
+	size_t margin = DEPTH_MARGIN;
+	while(true) {
+		size_t k = std::min(_stack_depth_,captured);
+		size_t m = std::min(_stack_depth_+margin,captured);
+		t.resize(k);
+		omniscio_symbol sym = _dictionary_.insert(t);
+		const omniscio_addr* frames = t.end();
+		size_t n = m - k;
+
+		if((size_t)sym >= _margins_.size()) {
+			_margins_.resize(sym+1);
+			_margin_known_.resize(sym+1,false);
+		}
+		if(not _margin_known_[sym]) {
+			_margins_[sym].assign(frames,frames+n);
+			_margin_known_[sym] = true;
+			return sym;
+		}
+
+		const std::vector<omniscio_addr>& known = _margins_[sym];
+		size_t i = 0;
+		while(i < known.size() && i < n && known[i] == frames[i]) i++;
+		if((i == known.size() && i == n)
+		|| _stack_depth_ >= MAX_STACK_DEPTH) return sym;
+
+		// sym stands for two call sites: deepen and try again
+		__atomic_store_n(&_stack_depth_,std::min(_stack_depth_+i+1,
+				(size_t)MAX_STACK_DEPTH),__ATOMIC_RELAXED);
+		_margins_.clear();
+		_margin_known_.clear();
+	}
+}
+
+/**
+ * Finds the entry of the call site cache for the given return
+ * addresses. The cache is direct-mapped: a new key replaces
+ * the entry that had the same position.
+ */
+static callsite* find_callsite(callsite* cache,
+				const omniscio_addr* key, size_t n)
+{
+	uint64_t h = 14695981039346656037ULL;
+	for(size_t i = 0; i < n; i++) {
+		h ^= (uint64_t)(uintptr_t)key[i];
+		h *= 1099511628211ULL;
+	}
+	h ^= h >> 32;
+	callsite* c = &cache[h & (CALLSITE_CACHE_SIZE-1)];
+	if(c->sym == 0 || not std::equal(key,key+n,c->key)) {
+		std::copy(key,key+n,c->key);
+		c->sym = 0;
+		c->checks = 0;
+		c->ambiguous = false;
+	}
+	return c;
+}
+
+/**
+ * Counts the innermost frames that return into an ENTRY_POINT, which
+ * belong to Omnisc'IO and not to the call site.
+ */
+static size_t entry_frames(const omniscio_addr* frames, size_t n)
+{
+	uintptr_t start = (uintptr_t)__start_omniscio_entry;
+	uintptr_t end = (uintptr_t)__stop_omniscio_entry;
+	size_t i = 0;
+	while(i < n && (uintptr_t)frames[i] > start 
+		&& (uintptr_t)frames[i] <= end) i++;
+	return i;
+}
+
+/**
+ * Captures the current stack and converts it into a symbol, skipping
+ * the frames outside of the application.
+ *
+ * The _callsite_key_ innermost return addresses of the application,
+ * read with the same unwinder past the frames of Omnisc'IO and of the
+ * wrappers, are first looked up in the call site cache of the thread
+ * (also when the cache is disabled but the thread is over its overhead
+ * budget). Once CALLSITE_CHECKS full lookups have given the same symbol
+ * for a key, the symbol is returned without unwinding the whole stack
+ * nor locking. A key that led to different symbols is never trusted
+ * again.
+ * \param[in] ts : state of the calling thread.
+ * \return the symbol, 0 if the stack could not be captured.
+ */
+static omniscio_symbol __attribute__((noinline)) ENTRY_POINT
+current_symbol(thread_state* ts)
+{
+	omniscio_date entered = _profile_ ? now() : 0.0;
+	unsigned long generation = 
+		__atomic_load_n(&_callsite_generation_,__ATOMIC_ACQUIRE);
+	if(ts->generation != generation) {
+		std::memset(ts->callsites,0,sizeof(ts->callsites));
+		ts->generation = generation;
+	}
+
+	callsite* c = NULL;
+	size_t k = _callsite_key_;
+	// over the overhead budget, even if the cache was disabled
+	if(k == 0 && ts->level >= LEVEL_HOT_SITES) k = CALLSITE_KEY;
+	if(k > 0) {
+		// the first addresses are in Omnisc'IO
+		omniscio_addr key[CALLSITE_MAX_KEY+SKIP_SLACK];
+		size_t n = unwind(key,k+SKIP_SLACK);
+		n = trace::filter_frames(key,n);
+		size_t skipped = entry_frames(key,n);
+		if(n >= skipped + k) {
+			c = find_callsite(ts->callsites,key+skipped,k);
+			if(c->checks >= CALLSITE_CHECKS && not c->ambiguous) {
+				ts->callsite_hits += 1;
+				if(_profile_) charge(ts,OMNISCIO_STAGE_UNWIND,
+						to_ns(now()-entered));
+				return c->sym;
+			}
+		}
+		ts->callsite_misses += 1;
+	}
+
+	size_t margin = _adaptive_depth_ ? DEPTH_MARGIN : 0;
+	size_t depth = __atomic_load_n(&_stack_depth_,__ATOMIC_RELAXED);
+	trace t(depth + margin + SKIP_SLACK);
+	// the first frames are this function and its callers in Omnisc'IO
+	t.skip(entry_frames(t.begin(),t.size()));
+	if(t.empty()) return 0;
+	omniscio_date unwound = _profile_ ? now() : 0.0;
+
+	pthread_mutex_lock(&_symbol_lock_);
+	t.normalize();
+	depth = _stack_depth_;
+	omniscio_symbol sym = stack_symbol(t);
+	if(depth != _stack_depth_) {
+		// symbols changed with the depth
+		__atomic_fetch_add(&_callsite_generation_,1,__ATOMIC_RELEASE);
+		c = NULL;
+	}
+	pthread_mutex_unlock(&_symbol_lock_);
+
+	if(c != NULL) {
+		if(c->sym == 0) c->sym = sym;
+		if(c->sym == sym) c->checks += 1;
+		else c->ambiguous = true;
+	}
+	if(_profile_) {
+		charge(ts,OMNISCIO_STAGE_UNWIND,to_ns(unwound-entered));
+		charge(ts,OMNISCIO_STAGE_DICTIONARY,to_ns(now()-unwound));
+	}
+	return sym;
+}
+
+static void write_event(const event& e)
 {
-	if(_previous_sym_ == 0) return;
+	if(_log_format_ == LOG_COMPRESSED) {
+		OMNISCIO_UNTRACED_START;
+		_zlog_.encode(e);
+		OMNISCIO_UNTRACED_END;
+		_operations_.get_stream().commit();
+		return;
+	}
+	if(_log_format_ == LOG_BINARY) {
+		OMNISCIO_UNTRACED_START;
+		_binlog_.write(e);
+		OMNISCIO_UNTRACED_END;
+		_operations_.get_stream().commit();
+		return;
+	}
+
+	_operations_ << e.start << ' ' << e.sym << ' '
+		<< _op_name_[e.op] << ' ' << _api_name_[e.api];
+	switch(e.op) {
+	case OMNISCIO_OPEN:
+		_operations_ << " _ " << e.name;
+		break;
+	case OMNISCIO_CLOSE:
+		_operations_ << " _ _";
+		break;
+	default:
+		_operations_ << ' ' << e.offset << ' ' << e.size;
+	}
+	_operations_ << ' ' << e.fd << ' ' << e.ret << ' ' << e.end << '\n';
+	_operations_.get_stream().commit();
+	if(e.op == OMNISCIO_OPEN) _operations_.flush();
+}
+
+void log_event(const event& e)
+{
+	omniscio_date entered = _profile_ ? now() : 0.0;
+	pthread_mutex_lock(&_log_lock_);
+	// an operation in flight when finalize closed the logs is dropped
+	if(_enabled_) write_event(e);
+	pthread_mutex_unlock(&_log_lock_);
+	if(_profile_ && _thread_ != NULL)
+		charge(_thread_,OMNISCIO_STAGE_LOGGING,to_ns(now()-entered));
+}
+
+/**
+ * Feeds the offset of an operation to the tracker of the transition
+ * from the previous operation on the same file.
+ * \param[in] f : last operation on the file.
+ * \param[in] current : offset of the operation.
+ * \param[in] sym : symbol of the operation.
+ */
+void update_offset(const file_state& f, omniscio_offset current,
+		omniscio_symbol sym) 
+{
+	if(f.sym == 0) return;
 
 	offset_op op;
-	if((omniscio_offset)(_previous_offset_ + _previous_size_) == current) {
-		_offset_table_(_previous_sym_,sym).input(op);
+	if((omniscio_offset)(f.offset + f.size) == current) {
+		_offset_table_(f.sym,sym).input(op);
 	} else {
 		if(current == 0) {
 			op = offset_op(current,offset_op::ABSOLUTE);
 		} else {
-			long relative = 
-				current - (_previous_offset_ + _previous_size_);
+			long relative = current - (f.offset + f.size);
 			op = offset_op(relative,offset_op::RELATIVE);
 		}
-		_offset_table_(_previous_sym_,sym).input(op);
+		_offset_table_(f.sym,sym).input(op);
 	}
 }
 
-int open_start(const char* filename, omniscio_api_type api)
+/**
+ * Feeds an operation to the model and to the tables, or forgets a
+ * closed file, _model_lock_ must be held.
+ */
+static void learn(const update& u)
 {
-	if(not _enabled_) return OMNISCIO_OK;
-	if(_started_) return OMNISCIO_ERROR;
-	_started_ = true;
-
-	_current_date_ = MPI_Wtime();
-
-	// create or read symbol from trace
-	trace t(256);
-	if(t.size() == 0) return OMNISCIO_ERROR;
-	omniscio_symbol sym = _dictionary_.insert(t);
-
-	// logging the current operation
-	omniscio_date now = MPI_Wtime();
-	_operations_ << now << ' ' << sym
-		<< " OPEN " << _api_name_[api]
-		<< " _ " << filename;
+	if(u.op == FORGET_FILE) {
+		_files_.erase(u.file);
+		return;
+	}
+	omniscio_date entered = _profile_ ? now() : 0.0;
 
 	// inserting symbol
-	_model_ << sym;
+	_model_ << u.sym;
+	omniscio_date learned = _profile_ ? now() : 0.0;
 
 	// update type
-	_type_table_(sym) = OMNISCIO_OPEN;
+	_type_table_(u.sym) = (omniscio_op_type)u.op;
 
 	// updating statistics on transition time
-	if(_previous_sym_ != 0) {
-		_time_table_(_previous_sym_,sym)
-			+= (_current_date_ - _previous_date_);
+	if(_previous_sym_ != 0 && u.interval >= 0) {
+		_time_table_(_previous_sym_,u.sym) += u.interval;
 	}
-	
+
 	// updating statistics on size
-	_size_table_(sym).input(0);
+	_size_table_(u.sym).input(u.size);
 
 	// updating statistics on offset
-	update_offset(0,sym);
+	file_state& f = _files_[u.file];
+	update_offset(f,u.offset,u.sym);
 
 	// update global variables
-	_previous_size_ 	= 0;
-	_previous_offset_ 	= 0;
-	_previous_sym_ 		= sym;
+	f.sym 			= u.sym;
+	f.offset 		= u.offset;
+	f.size 			= u.size;
+	// the handle is not known yet when opening
+	if(u.op != OMNISCIO_OPEN) f.handle = u.handle;
+	_symbol_files_(u.sym) 	= u.file;
+	_previous_sym_ 		= u.sym;
+
+	if(_profile_) {
+		_learn_profile_[u.op][0].add(to_ns(learned-entered));
+		_learn_profile_[u.op][1].add(to_ns(now()-learned));
+	}
+}
 
-	return OMNISCIO_OK;
+static void predict(std::vector<omniscio_req>& result);
+
+/**
+ * Feeds the queued operations of all the threads to the model,
+ * _threads_lock_ and _model_lock_ must be held.
+ * \return the number of operations.
+ */
+static size_t drain()
+{
+	size_t n = 0;
+	update u;
+	for(size_t i = 0; i < _threads_.size(); i++) {
+		ring<update>& r = _threads_[i]->updates;
+		if(r.capacity() == 0) continue;
+		for(; r.pop(u); n++) learn(u);
+	}
+	return n;
 }
 
-int open_end(int success, omniscio_file fh)
+/**
+ * Body of the consumer thread in asynchronous mode. Queued operations
+ * are fed to the model by batches. Once predictions have been requested,
+ * they are computed again after each batch and published in _published_.
+ */
+static void* consume(void*)
 {
-	if(not _enabled_) return OMNISCIO_OK;
-	if(not _started_) return OMNISCIO_ERROR;
-	_started_ = false;
+	std::vector<omniscio_req> pred;
+	while(true) {
+		// every push happened before the stop request
+		bool stop = __atomic_load_n(&_stop_,__ATOMIC_ACQUIRE);
+		bool publish = __atomic_load_n(&_publish_,__ATOMIC_ACQUIRE);
+		pthread_mutex_lock(&_threads_lock_);
+		pthread_mutex_lock(&_model_lock_);
+		size_t n = drain();
+		if(n > 0 && publish) predict(pred);
+		pthread_mutex_unlock(&_model_lock_);
+		pthread_mutex_unlock(&_threads_lock_);
+
+		if(n > 0 && publish) {
+			pthread_mutex_lock(&_published_lock_);
+			_published_.swap(pred);
+			pthread_mutex_unlock(&_published_lock_);
+		} else if(n == 0) {
+			if(stop) break;
+			struct timespec ts = { 0, ASYNC_SLEEP_NS };
+			nanosleep(&ts,NULL);
+		}
+	}
+	return NULL;
+}
 
-	// logging the end of the current operation
-	omniscio_date now = MPI_Wtime();
-	_operations_ << ' ' << fh.handle.posix 
-		<< ' ' << success << ' ' << now << '\n';
-	_operations_.flush();
+/**
+ * Hands an operation over to the model, directly or through the queue
+ * of the thread in asynchronous mode.
+ * \param[in] ts : state of the calling thread.
+ * \param[in] sym : symbol of the operation.
+ * \param[in] op : type of the operation.
+ * \param[in] offset : offset of the operation.
+ * \param[in] size : size of the operation.
+ */
+static void record(thread_state* ts, omniscio_symbol sym, 
+		omniscio_op_type op, omniscio_offset offset, omniscio_size size)
+{
+	update u;
+	u.sym		= sym;
+	u.op		= op;
+	u.offset	= offset;
+	u.size		= size;
+	u.interval	= ts->previous_date == 0.0 ? -1.0 
+			: ts->current_date - ts->previous_date;
+	u.file		= ts->file;
+	u.handle	= ts->handle;
+
+	// over the overhead budget, 1 operation in 2^(level-1) is learned
+	if(ts->level > LEVEL_HOT_SITES) {
+		unsigned long period = 1UL << (ts->level - LEVEL_HOT_SITES);
+		if(ts->level >= LEVEL_PAUSED || ts->sampled++ % period != 0) {
+			ts->overhead_skipped += 1;
+			return;
+		}
+	}
 
-	_previous_date_ = MPI_Wtime();
+	if(not _async_) {
+		pthread_mutex_lock(&_model_lock_);
+		if(_enabled_) learn(u);
+		pthread_mutex_unlock(&_model_lock_);
+		return;
+	}
+	if(not ts->updates.push(u)) {
+		ts->async_drops += 1;
+		return;
+	}
+	long backlog = ts->updates.size();
+	if(backlog > ts->async_backlog) ts->async_backlog = backlog;
+}
 
-	return OMNISCIO_OK;
+/**
+ * Drops the state of a file once it has been closed, after the
+ * operations queued before the close in asynchronous mode. The files
+ * that are not known share their state, which is kept.
+ * \param[in] ts : state of the calling thread.
+ * \param[in] file : file closed.
+ */
+static void forget_file(thread_state* ts, file_h file)
+{
+	if(file == 0) return;
+	update u;
+	std::memset(&u,0,sizeof(u));
+	u.op	= FORGET_FILE;
+	u.file	= file;
+	if(not _async_) {
+		pthread_mutex_lock(&_model_lock_);
+		if(_enabled_) learn(u);
+		pthread_mutex_unlock(&_model_lock_);
+		return;
+	}
+	// the state is kept if the queue is full
+	ts->updates.push(u);
 }
 
-int close_start(omniscio_file fh)
+/**
+ * Destructor of the state of a thread, called when the thread exits.
+ * Its queued operations are fed to the model and its counters are
+ * added to _retired_ before the state is freed.
+ * \param[in] p : state of the thread.
+ */
+static void retire_thread(void* p)
+{
+	thread_state* ts = (thread_state*)p;
+	pthread_mutex_lock(&_threads_lock_);
+	if(ts->updates.capacity() > 0) {
+		pthread_mutex_lock(&_model_lock_);
+		update u;
+		while(ts->updates.pop(u)) learn(u);
+		pthread_mutex_unlock(&_model_lock_);
+	}
+	_threads_.erase(std::find(_threads_.begin(),_threads_.end(),ts));
+	if(_retired_ == NULL) {
+		_retired_ = new thread_state();
+		_threads_.push_back(_retired_);
+	}
+	_retired_->callsite_hits	+= ts->callsite_hits;
+	_retired_->callsite_misses	+= ts->callsite_misses;
+	_retired_->async_drops		+= ts->async_drops;
+	_retired_->async_backlog	= std::max(_retired_->async_backlog,
+						ts->async_backlog);
+	_retired_->overhead_skipped	+= ts->overhead_skipped;
+	_retired_->overhead_level	= std::max(_retired_->overhead_level,
+						ts->overhead_level);
+	if(ts->profile != NULL) {
+		if(_retired_->profile == NULL)
+			_retired_->profile = new histogram[4*PROFILE_STAGES];
+		for(int i = 0; i < 4*PROFILE_STAGES; i++)
+			_retired_->profile[i] += ts->profile[i];
+	}
+	pthread_mutex_unlock(&_threads_lock_);
+
+	// the thread may still do I/O in later destructors
+	_thread_ = NULL;
+	delete[] ts->profile;
+	delete ts;
+}
+
+static void create_thread_key()
+{
+	pthread_key_create(&_thread_key_,retire_thread);
+}
+
+/**
+ * Returns the state of the calling thread, created at its first call
+ * and retired when the thread exits.
+ */
+static thread_state* this_thread()
+{
+	if(_thread_ != NULL) return _thread_;
+	pthread_once(&_thread_key_once_,create_thread_key);
+	thread_state* ts = new thread_state();
+	if(_profile_) ts->profile = new histogram[4*PROFILE_STAGES];
+	pthread_mutex_lock(&_threads_lock_);
+	if(_async_capacity_ > 0) ts->updates.reserve(_async_capacity_);
+	_threads_.push_back(ts);
+	pthread_mutex_unlock(&_threads_lock_);
+	pthread_setspecific(_thread_key_,ts);
+	_thread_ = ts;
+	return ts;
+}
+
+int ENTRY_POINT open_start(const char* filename, omniscio_api_type api)
 {
 	if(not _enabled_) return OMNISCIO_OK;
-	if(_started_) return OMNISCIO_ERROR;
-	_started_ = true;
-	
-	_current_date_ = MPI_Wtime();
+	thread_state* ts = this_thread();
+	if(ts->started) return OMNISCIO_ERROR;
+	ts->started = true;
 
 	// create or read symbol from trace
-	trace t(256);
-	if(t.size() == 0) return OMNISCIO_ERROR;
-	omniscio_symbol sym = _dictionary_.insert(t);
+	omniscio_symbol sym = current_symbol(ts);
+	if(sym == 0) return OMNISCIO_ERROR;
+
+	// recording the current operation, the date is read once
+	ts->current_date = now();
+	ts->ev.start	= ts->current_date;
+	ts->ev.sym	= sym;
+	ts->ev.op	= OMNISCIO_OPEN;
+	ts->ev.api	= api;
+	ts->ev.offset	= 0;
+	ts->ev.size	= 0;
+	ts->ev.name	= filename;
+	ts->file	= file_from_name(filename);
+
+	// updating the model and the tables
+	record(ts,sym,OMNISCIO_OPEN,0,0);
 
-	// logging the current operation
-	omniscio_date now = MPI_Wtime();
-	_operations_ << now << ' ' << sym
-		<< " CLOSE " << _api_name_[fh.type]
-		<< " _ _ " << fh.handle.posix;
-	
-	// inserting symbol
-	_model_ << sym;
+	return OMNISCIO_OK;
+}
 
-	// update type
-	_type_table_(sym) = OMNISCIO_CLOSE;
+int open_end(int success, omniscio_file fh)
+{
+	if(not _enabled_) return OMNISCIO_OK;
+	thread_state* ts = this_thread();
+	if(not ts->started) return OMNISCIO_ERROR;
+	ts->started = false;
 
-	// updating statistics on transition time
-	if(_previous_sym_ != 0) {
-		_time_table_(_previous_sym_,sym)
-			+= (_current_date_ - _previous_date_);
-	}
+	// logging the current operation
+	ts->ev.end	= now();
+	ts->ev.fd	= fh.handle.posix;
+	ts->ev.ret	= success;
+	log_event(ts->ev);
+	if(success == 0) open_file(ts->ev.name,fh);
 
-	// update statistics on size
-	_size_table_(sym).input(0);
+	ts->previous_date = ts->ev.end;
 
-	// updating statistics on offset
-	update_offset(0,sym);
+	return OMNISCIO_OK;
+}
 
-	// update global variables
-	_previous_size_         = 0;
-	_previous_offset_       = 0;
-	_previous_sym_          = sym;
+int ENTRY_POINT close_start(omniscio_file fh)
+{
+	if(not _enabled_) return OMNISCIO_OK;
+	thread_state* ts = this_thread();
+	if(ts->started) return OMNISCIO_ERROR;
+	ts->started = true;
+	
+	// create or read symbol from trace
+	omniscio_symbol sym = current_symbol(ts);
+	if(sym == 0) return OMNISCIO_ERROR;
+
+	// recording the current operation, the date is read once
+	ts->current_date = now();
+	ts->ev.start	= ts->current_date;
+	ts->ev.sym	= sym;
+	ts->ev.op	= OMNISCIO_CLOSE;
+	ts->ev.api	= fh.type;
+	ts->ev.offset	= 0;
+	ts->ev.size	= 0;
+	ts->ev.fd	= fh.handle.posix;
+	ts->ev.name	= NULL;
+	ts->file	= find_file(fh);
+	ts->handle	= fh;
+	
+	// updating the model and the tables
+	record(ts,sym,OMNISCIO_CLOSE,0,0);
 
 	return OMNISCIO_OK;
 }
@@ -242,59 +1134,50 @@ int close_start(omniscio_file fh)
 int close_end(int success)
 {
 	if(not _enabled_) return OMNISCIO_OK;
-	if(not _started_) return OMNISCIO_ERROR;
-	_started_ = false;
+	thread_state* ts = this_thread();
+	if(not ts->started) return OMNISCIO_ERROR;
+	ts->started = false;
 	
-	// logging the end of the current operation
-	omniscio_date now = MPI_Wtime();
-	_operations_ << ' ' << success << ' ' << now << '\n';
+	// logging the current operation
+	ts->ev.end	= now();
+	ts->ev.ret	= success;
+	log_event(ts->ev);
+	if(success == 0) {
+		forget_file(ts,ts->file);
+		close_file(ts->handle);
+	}
 
-	_previous_date_ = MPI_Wtime();
+	ts->previous_date = ts->ev.end;
 
 	return OMNISCIO_OK;
 }
 
-int write_start(omniscio_file fh, omniscio_offset offset, omniscio_size size)
+int ENTRY_POINT write_start(omniscio_file fh, omniscio_offset offset, omniscio_size size)
 {
 	if(not _enabled_) return OMNISCIO_OK;
-	if(_started_) return OMNISCIO_ERROR;
-	_started_ = true;
-
-	_current_date_ = MPI_Wtime();
+	thread_state* ts = this_thread();
+	if(ts->started) return OMNISCIO_ERROR;
+	ts->started = true;
 
 	// create or read symbol from trace
-	trace t(256);
-	if(t.size() == 0) return OMNISCIO_ERROR;
-	omniscio_symbol sym = _dictionary_.insert(t);
-
-	// logging the current operation
-	omniscio_date now = MPI_Wtime();
-	_operations_ << now << ' ' << sym
-		<< " WRITE " << _api_name_[fh.type]
-		<< ' ' << offset << ' ' << size << ' ' << fh.handle.posix;
-
-	// inserting symbol
-	_model_ << sym;
-
-	// update type
-	_type_table_(sym) = OMNISCIO_WRITE;
-
-	// updating statistics on transition time
-	if(_previous_sym_ != 0) {
-		_time_table_(_previous_sym_,sym)
-			+= (_current_date_ - _previous_date_);
-	}
-
-	// updating statistics on size
-	_size_table_(sym).input(size);
-
-	// updating statistics on offset
-	update_offset(offset,sym);
-
-	// update global variables
-	_previous_size_         = size;
-	_previous_offset_       = offset;
-	_previous_sym_          = sym;
+	omniscio_symbol sym = current_symbol(ts);
+	if(sym == 0) return OMNISCIO_ERROR;
+
+	// recording the current operation, the date is read once
+	ts->current_date = now();
+	ts->ev.start	= ts->current_date;
+	ts->ev.sym	= sym;
+	ts->ev.op	= OMNISCIO_WRITE;
+	ts->ev.api	= fh.type;
+	ts->ev.offset	= offset;
+	ts->ev.size	= size;
+	ts->ev.fd	= fh.handle.posix;
+	ts->ev.name	= NULL;
+	ts->file	= find_file(fh);
+	ts->handle	= fh;
+
+	// updating the model and the tables
+	record(ts,sym,OMNISCIO_WRITE,offset,size);
 
 	return OMNISCIO_OK;
 }
@@ -302,75 +1185,384 @@ int write_start(omniscio_file fh, omniscio_offset offset, omniscio_size size)
 int write_end(int success)
 {
 	if(not _enabled_) return OMNISCIO_OK;
-	if(not _started_) return OMNISCIO_ERROR;
-	_started_ = false;
+	thread_state* ts = this_thread();
+	if(not ts->started) return OMNISCIO_ERROR;
+	ts->started = false;
 
-	// logging the end of the current operation
-	omniscio_date now = MPI_Wtime();
-	_operations_ << ' ' << success << ' ' << now << '\n';
+	// logging the current operation
+	ts->ev.end	= now();
+	ts->ev.ret	= success;
+	log_event(ts->ev);
 
-	_previous_date_ = MPI_Wtime();
+	ts->previous_date = ts->ev.end;
 
 	return OMNISCIO_OK;
 }
 
-int read_start(omniscio_file fh, omniscio_offset offset, omniscio_size size)
+int ENTRY_POINT read_start(omniscio_file fh, omniscio_offset offset, omniscio_size size)
 {
 	if(not _enabled_) return OMNISCIO_OK;
-	if(_started_) return OMNISCIO_ERROR;
-	_started_ = true;
-
-	_current_date_ = MPI_Wtime();
+	thread_state* ts = this_thread();
+	if(ts->started) return OMNISCIO_ERROR;
+	ts->started = true;
 
 	// create or read symbol from trace
-	trace t(256);
-	if(t.size() == 0) return OMNISCIO_ERROR;
-	omniscio_symbol sym = _dictionary_.insert(t);
+	omniscio_symbol sym = current_symbol(ts);
+	if(sym == 0) return OMNISCIO_ERROR;
+
+	// recording the current operation, the date is read once
+	ts->current_date = now();
+	ts->ev.start	= ts->current_date;
+	ts->ev.sym	= sym;
+	ts->ev.op	= OMNISCIO_READ;
+	ts->ev.api	= fh.type;
+	ts->ev.offset	= offset;
+	ts->ev.size	= size;
+	ts->ev.fd	= fh.handle.posix;
+	ts->ev.name	= NULL;
+	ts->file	= find_file(fh);
+	ts->handle	= fh;
+
+	// updating the model and the tables
+	record(ts,sym,OMNISCIO_READ,offset,size);
+	
+	return OMNISCIO_OK;
+}
+
+int read_end(int success)
+{
+	if(not _enabled_) return OMNISCIO_OK;
+	thread_state* ts = this_thread();
+	if(not ts->started) return OMNISCIO_ERROR;
+	ts->started = false;
 
 	// logging the current operation
-	omniscio_date now = MPI_Wtime();
-	_operations_ << now << ' ' << sym
-		<< " READ " << _api_name_[fh.type]
-		<< ' ' << offset << ' ' << size << ' ' << fh.handle.posix;
+	ts->ev.end	= now();
+	ts->ev.ret	= success;
+	log_event(ts->ev);
 
-	// inserting symbol
-	_model_ << sym;
+	ts->previous_date = ts->ev.end;
 
-	// update type
-	_type_table_(sym) = OMNISCIO_READ;
+	return OMNISCIO_OK;
+}
 
-	// updating statistics on transition time
-	if(_previous_sym_ != 0) {
-		_time_table_(_previous_sym_,sym)
-			+= (_current_date_ - _previous_date_);
+int get_stats(omniscio_stats* stats)
+{
+	if(stats == NULL) return OMNISCIO_ERROR;
+	pthread_mutex_lock(&_model_lock_);
+	sequitur::oracle::statistics s = _model_.get_statistics();
+	pthread_mutex_unlock(&_model_lock_);
+	stats->rules_created		= s.rules_created;
+	stats->rules_destroyed		= s.rules_destroyed;
+	stats->matches			= s.matches;
+	stats->substitutions		= s.substitutions;
+	stats->expansions		= s.expansions;
+	stats->digrams			= s.digrams;
+	stats->predictors		= s.predictors;
+	stats->predictor_searches	= s.predictor_searches;
+	stats->inputs			= s.inputs;
+	stats->input_time		= s.input_time;
+	stats->rebuilds			= s.rebuilds;
+	stats->refusals			= s.refusals;
+	stats->freezes			= s.freezes;
+	stats->frozen_inputs		= s.frozen_inputs;
+	stats->learning_time		= s.learning_time;
+	stats->frozen_time		= s.frozen_time;
+	stats->callsite_hits		= 0;
+	stats->callsite_misses		= 0;
+	stats->async_drops		= 0;
+	stats->async_backlog		= 0;
+	stats->threads			= 0;
+	stats->overhead_skipped		= 0;
+	stats->overhead_level		= 0;
+	stats->overhead_current		= 0;
+	pthread_mutex_lock(&_threads_lock_);
+	stats->threads = _threads_.size() - (_retired_ != NULL ? 1 : 0);
+	for(size_t i = 0; i < _threads_.size(); i++) {
+		const thread_state* ts = _threads_[i];
+		stats->callsite_hits	+= ts->callsite_hits;
+		stats->callsite_misses	+= ts->callsite_misses;
+		stats->async_drops	+= ts->async_drops;
+		stats->async_backlog	= std::max(stats->async_backlog,
+						ts->async_backlog);
+		stats->overhead_skipped	+= ts->overhead_skipped;
+		stats->overhead_level	= std::max(stats->overhead_level,
+						ts->overhead_level);
+		stats->overhead_current	= std::max(stats->overhead_current,
+						(long)ts->level);
 	}
+	pthread_mutex_unlock(&_threads_lock_);
+	stats->log_dropped		= writer_dropped();
+	return OMNISCIO_OK;
+}
 
-	// updating statistics on size
-	_size_table_(sym).input(size);
+static void dump_stats(const std::string& filename)
+{
+	omniscio_stats s;
+	get_stats(&s);
+	logstream<std::ofstream> out;
+	out.open(filename);
+	out << "rules_created " << s.rules_created << '\n'
+	    << "rules_destroyed " << s.rules_destroyed << '\n'
+	    << "matches " << s.matches << '\n'
+	    << "substitutions " << s.substitutions << '\n'
+	    << "expansions " << s.expansions << '\n'
+	    << "digrams " << s.digrams << '\n'
+	    << "predictors " << s.predictors << '\n'
+	    << "predictor_searches " << s.predictor_searches << '\n'
+	    << "inputs " << s.inputs << '\n'
+	    << "input_time_ns " << s.input_time << '\n'
+	    << "rebuilds " << s.rebuilds << '\n'
+	    << "refusals " << s.refusals << '\n'
+	    << "freezes " << s.freezes << '\n'
+	    << "frozen_inputs " << s.frozen_inputs << '\n'
+	    << "learning_time_ns " << s.learning_time << '\n'
+	    << "frozen_time_ns " << s.frozen_time << '\n'
+	    << "callsite_hits " << s.callsite_hits << '\n'
+	    << "callsite_misses " << s.callsite_misses << '\n'
+	    << "async_drops " << s.async_drops << '\n'
+	    << "async_backlog " << s.async_backlog << '\n'
+	    << "threads " << s.threads << '\n'
+	    << "log_dropped " << s.log_dropped << '\n'
+	    << "overhead_skipped " << s.overhead_skipped << '\n'
+	    << "overhead_level " << s.overhead_level << '\n'
+	    << "overhead_current " << s.overhead_current << '\n';
+	out.close();
+}
 
-	// updating statistics on offset
-	update_offset(offset,sym);
+/**
+ * Sums the histograms of a stage of the operations of a type over all
+ * the threads.
+ */
+static void merge_profile(int op, int stage, histogram& result)
+{
+	result.clear();
+	if(stage == OMNISCIO_STAGE_MODEL || stage == OMNISCIO_STAGE_TRACKERS) {
+		pthread_mutex_lock(&_model_lock_);
+		result += _learn_profile_[op][stage-OMNISCIO_STAGE_MODEL];
+		pthread_mutex_unlock(&_model_lock_);
+		return;
+	}
+	pthread_mutex_lock(&_threads_lock_);
+	for(size_t i = 0; i < _threads_.size(); i++) {
+		const histogram* h = _threads_[i]->profile;
+		if(h != NULL) result += h[op*PROFILE_STAGES+stage];
+	}
+	pthread_mutex_unlock(&_threads_lock_);
+}
 
-	// update global variables
-	_previous_size_         = size;
-	_previous_offset_       = offset;
-	_previous_sym_          = sym;
-	
+static bool valid_profile(int op, int stage)
+{
+	return _profile_ && op >= OMNISCIO_OPEN && op <= OMNISCIO_WRITE
+		&& stage >= 0 && stage < PROFILE_STAGES;
+}
+
+int get_profile(omniscio_op_type op, omniscio_stage stage,
+		omniscio_profile* profile)
+{
+	if(profile == NULL || not valid_profile(op,stage))
+		return OMNISCIO_ERROR;
+	histogram h;
+	merge_profile(op,stage,h);
+	profile->count	= h.get_count();
+	profile->total	= h.get_total();
+	profile->p50	= h.percentile(50.0);
+	profile->p99	= h.percentile(99.0);
+	profile->max	= h.get_max();
 	return OMNISCIO_OK;
 }
 
-int read_end(int success)
+int get_percentile(omniscio_op_type op, omniscio_stage stage,
+		double percent, long long* ns)
 {
-	if(not _enabled_) return OMNISCIO_OK;
-	if(not _started_) return OMNISCIO_ERROR;
-	_started_ = false;
+	if(ns == NULL || not valid_profile(op,stage)) return OMNISCIO_ERROR;
+	histogram h;
+	merge_profile(op,stage,h);
+	*ns = h.percentile(percent);
+	return OMNISCIO_OK;
+}
 
-	// logging the end of the current operation
-	omniscio_date now = MPI_Wtime();
-	_operations_ << ' ' << success << ' ' << now << '\n';
+static void dump_profile(const std::string& filename)
+{
+	static const char* stage_name[PROFILE_STAGES] = 
+		{"unwind","dictionary","model","trackers","logging","total"};
+	logstream<std::ofstream> out;
+	out.open(filename);
+	out << "# op stage count total_ns p50_ns p90_ns p99_ns max_ns\n";
+	histogram h;
+	for(int op = OMNISCIO_OPEN; op <= OMNISCIO_WRITE; op++) {
+		for(int s = 0; s < PROFILE_STAGES; s++) {
+			merge_profile(op,s,h);
+			if(h.get_count() == 0) continue;
+			out << _op_name_[op] << ' ' << stage_name[s] << ' '
+			    << h.get_count() << ' ' << h.get_total() << ' '
+			    << h.percentile(50.0) << ' ' 
+			    << h.percentile(90.0) << ' '
+			    << h.percentile(99.0) << ' ' << h.get_max() << '\n';
+		}
+	}
+	out.close();
+}
+
+/**
+ * Collective over MPI_COMM_WORLD. Rank 0 gathers the call stacks of
+ * all the ranks and numbers them again, in the order of the ranks then
+ * of their local symbols. Each rank then renames its symbols in the
+ * dictionary, the grammar and the tables. Rank 0 writes the global
+ * dictionary (<base>dict and <base>bdict), the modules of all the ranks
+ * (<base>modules) and, in <base>symmap, one "[rank]: local:global ..."
+ * line per rank to translate the logs written so far.
+ * The ranks number their next symbols from the same global count, so
+ * the call stacks seen after unify get symbols that may collide across
+ * ranks: it is meant to be called once, at the end (as finalize does).
+ * Disjoint ranges per rank are not reserved, the tables being indexed
+ * by symbol.
+ */
+static void unify_ranks()
+{
+	OMNISCIO_UNTRACED_START;
+
+	int rank, size;
+	MPI_Comm_size(MPI_COMM_WORLD,&size);
+	MPI_Comm_rank(MPI_COMM_WORLD,&rank);
 
-	_previous_date_ = MPI_Wtime();
+	// the queued operations use the local symbols
+	pthread_mutex_lock(&_threads_lock_);
+	pthread_mutex_lock(&_model_lock_);
+	pthread_mutex_lock(&_symbol_lock_);
+	drain();
+
+	std::vector<omniscio_symbol> ids;
+	std::vector<size_t> lengths;
+	std::vector<omniscio_addr> seqs;
+	_dictionary_.get_entries(ids,lengths,seqs);
+	std::vector<int> len(lengths.begin(),lengths.end());
+	std::string mods = describe_modules();
+
+	// counts of entries, letters and module characters of each rank
+	int mine[3] = { (int)ids.size(), (int)seqs.size(), (int)mods.size() };
+	std::vector<int> counts(3*size);
+	MPI_Gather(mine,3,MPI_INT,&counts[0],3,MPI_INT,0,MPI_COMM_WORLD);
+
+	std::vector<int> num(size), lsize(size), msize(size);
+	std::vector<int> ndispl(size), ldispl(size), mdispl(size);
+	if(rank == 0) {
+		for(int r = 0; r < size; r++) {
+			num[r] = counts[3*r];
+			lsize[r] = counts[3*r+1]*sizeof(omniscio_addr);
+			msize[r] = counts[3*r+2];
+			if(r > 0) {
+				ndispl[r] = ndispl[r-1] + num[r-1];
+				ldispl[r] = ldispl[r-1] + lsize[r-1];
+				mdispl[r] = mdispl[r-1] + msize[r-1];
+			}
+		}
+	}
+	size_t total_num = rank == 0 ? ndispl[size-1] + num[size-1] : 0;
+	size_t total_letters = rank == 0 ? 
+		(ldispl[size-1] + lsize[size-1])/sizeof(omniscio_addr) : 0;
+	size_t total_mods = rank == 0 ? mdispl[size-1] + msize[size-1] : 0;
+
+	// +1 so that the buffers are never empty
+	std::vector<int> all_len(total_num+1);
+	std::vector<omniscio_addr> all_seqs(total_letters+1);
+	std::vector<char> all_mods(total_mods+1);
+	len.push_back(0);
+	seqs.push_back(0);
+	mods.push_back('\0');
+	MPI_Gatherv(&len[0],mine[0],MPI_INT,
+		&all_len[0],&num[0],&ndispl[0],MPI_INT,0,MPI_COMM_WORLD);
+	MPI_Gatherv(&seqs[0],mine[1]*sizeof(omniscio_addr),MPI_BYTE,
+		&all_seqs[0],&lsize[0],&ldispl[0],MPI_BYTE,0,MPI_COMM_WORLD);
+	MPI_Gatherv(&mods[0],mine[2],MPI_CHAR,
+		&all_mods[0],&msize[0],&mdispl[0],MPI_CHAR,0,MPI_COMM_WORLD);
+
+	std::vector<int> all_ids(total_num+1);
+	ids.push_back(0);
+	MPI_Gatherv(&ids[0],mine[0],MPI_INT,
+		&all_ids[0],&num[0],&ndispl[0],MPI_INT,0,MPI_COMM_WORLD);
+
+	std::vector<int> all_global(total_num+1);
+	int next = 0;
+	if(rank == 0) {
+		dictionary<omniscio_addr,omniscio_symbol> global;
+		std::ofstream symmap((_base_+"symmap").c_str());
+		const omniscio_addr* seq = &all_seqs[0];
+		for(int r = 0; r < size; r++) {
+			symmap << "[" << r << "]:";
+			for(int i = ndispl[r]; i < ndispl[r]+num[r]; i++) {
+				all_global[i] = global.insert(seq,seq+all_len[i]);
+				seq += all_len[i];
+				symmap << ' ' << all_ids[i] << ':' << all_global[i];
+			}
+			symmap << '\n';
+		}
+		symmap.close();
+		next = global.next_index();
+		global.write(_base_+"dict");
+		global.save(_base_+"bdict");
+
+		// modules are identified by their key (first 8 characters)
+		std::set<std::string> keys;
+		std::stringstream ms(std::string(all_mods.begin(),
+					all_mods.begin()+total_mods));
+		std::ofstream mf((_base_+"modules").c_str());
+		std::string line;
+		while(std::getline(ms,line)) {
+			if(keys.insert(line.substr(0,8)).second)
+				mf << line << '\n';
+		}
+		mf.close();
+	}
 
+	std::vector<int> global_ids(mine[0]+1);
+	MPI_Scatterv(&all_global[0],&num[0],&ndispl[0],MPI_INT,
+		&global_ids[0],mine[0],MPI_INT,0,MPI_COMM_WORLD);
+	MPI_Bcast(&next,1,MPI_INT,0,MPI_COMM_WORLD);
+
+	// m[local symbol] = global symbol
+	std::vector<int> m(1,0);
+	for(int i = 0; i < mine[0]; i++) {
+		if((size_t)ids[i] >= m.size()) m.resize(ids[i]+1,0);
+		m[ids[i]] = global_ids[i];
+	}
+
+	_dictionary_.remap(m,next);
+	_model_.remap(m);
+	_time_table_.remap(m);
+	_size_table_.remap(m);
+	_offset_table_.remap(m);
+	_type_table_.remap(m);
+	_symbol_files_.remap(m);
+	if((size_t)_previous_sym_ < m.size()) 
+		_previous_sym_ = m[_previous_sym_];
+	std::map<file_h,file_state>::iterator fi = _files_.begin();
+	for(; fi != _files_.end(); fi++) {
+		if((size_t)fi->second.sym < m.size()) 
+			fi->second.sym = m[fi->second.sym];
+	}
+	for(size_t i = 0; i < _threads_.size(); i++) {
+		event& e = _threads_[i]->ev;
+		if((size_t)e.sym < m.size()) e.sym = m[e.sym];
+	}
+	__atomic_fetch_add(&_callsite_generation_,1,__ATOMIC_RELEASE);
+	_margins_.clear();
+	_margin_known_.clear();
+	pthread_mutex_unlock(&_symbol_lock_);
+	pthread_mutex_unlock(&_model_lock_);
+	pthread_mutex_unlock(&_threads_lock_);
+
+	OMNISCIO_UNTRACED_END;
+}
+
+/**
+ * Unifies the symbols of all the ranks (see unify_ranks).
+ * \return OMNISCIO_OK in case of success, OMNISCIO_ERROR otherwise.
+ */
+int unify(void)
+{
+	if(not _enabled_) return OMNISCIO_ERROR;
+	unify_ranks();
 	return OMNISCIO_OK;
 }
 
@@ -378,57 +1570,203 @@ int finalize(void)
 {
 	if(not _enabled_) return OMNISCIO_OK;
 
+	// nothing is traced from here on; the operations in flight finish
+	// under the locks taken below before anything is closed
+	_enabled_ = false;
+	omniscio_tracing_enabled = 0;
+
+	if(_async_) {
+		__atomic_store_n(&_stop_,1,__ATOMIC_RELEASE);
+		pthread_join(_consumer_,NULL);
+		_async_ = false;
+	}
+
+	if(_dump_stats_) dump_stats(_prefix_+"stats");
+	if(_profile_) dump_profile(_prefix_+"profile");
+
+	if(_unify_) unify_ranks();
+
+	pthread_mutex_lock(&_model_lock_);
+	pthread_mutex_lock(&_symbol_lock_);
+	if(not _unify_) _dictionary_.save(_prefix_+"bdict");
 	_dictionary_.close();
+	close_modules();
+	pthread_mutex_unlock(&_symbol_lock_);
 	_model_.close();
 	//_time_table_.close();
 	//_size_table_.close();
 	//_offset_table_.close();
 	//_type_table_.close();
 	_predictions_.close();
-	_operations_.close();
-	_enabled_ = false;
-	_started_ = false;
+	pthread_mutex_unlock(&_model_lock_);
 
-	omniscio_tracing_enabled = 0;
+	pthread_mutex_lock(&_log_lock_);
+	OMNISCIO_UNTRACED_START;
+	if(_zlog_.is_open()) _zlog_.close();
+	if(_binlog_.is_open()) _binlog_.close();
+	OMNISCIO_UNTRACED_END;
+	_operations_.close();
+	stop_writer();
+	pthread_mutex_unlock(&_log_lock_);
+	if(_thread_ != NULL) _thread_->started = false;
 
 	return OMNISCIO_OK;
 }
 
+/**
+ * Predicts the operation corresponding to a symbol from the tables,
+ * without modifying them. _model_lock_ must be held.
+ * \param[in] next : predicted symbol.
+ * \param[in] proba : probability of the symbol.
+ * \param[out] req : predicted operation.
+ */
+static void predict_request(omniscio_symbol next, double proba,
+				omniscio_req& req)
+{
+	const vector<size_tracker>& sizes = _size_table_;
+	const matrix<offset_tracker>& offsets = _offset_table_;
+	const matrix<adaptive_stats<double> >& times = _time_table_;
+	const vector<omniscio_op_type>& types = _type_table_;
+	const vector<file_h>& files = _symbol_files_;
+
+	std::memset(&req,0,sizeof(req));
+	// predict the size
+	req.size = sizes(next).predict();
+	// predict the offset, in the file the symbol accessed last
+	std::map<file_h,file_state>::const_iterator f 
+		= _files_.find(files(next));
+	if(f != _files_.end()) {
+		offset_op op = offsets(f->second.sym,next).predict();
+		req.offset = op.get_offset_after(f->second.offset,
+						 f->second.size);
+		req.fh = f->second.handle;
+	}
+	// predict the date
+	req.date = times(_previous_sym_,next).get_adapted();
+	// predict the type
+	req.type = types(next);
+	// set probability
+	req.proba = proba;
+}
+
+// appends the predictions to a vector
+struct append_requests {
+	std::vector<omniscio_req>& result;
+	append_requests(std::vector<omniscio_req>& r) : result(r) {}
+	void operator()(omniscio_symbol next, double proba) {
+		result.push_back(omniscio_req());
+		predict_request(next,proba,result.back());
+	}
+};
+
+// keeps, in a fixed array, the most probable predictions above
+// a threshold, sorted by decreasing probability
+struct keep_requests {
+	omniscio_req* buf;
+	int cap;
+	double threshold;
+	int n;
+	keep_requests(omniscio_req* b, int c, double t)
+	: buf(b), cap(c), threshold(t), n(0) {}
+	bool wanted(double proba) const {
+		return proba >= threshold 
+			&& (n < cap || (cap > 0 && buf[cap-1].proba < proba));
+	}
+	void keep(const omniscio_req& req) {
+		if(not wanted(req.proba)) return;
+		int i = std::min(n,cap-1);
+		for(; i > 0 && buf[i-1].proba < req.proba; i--)
+			buf[i] = buf[i-1];
+		buf[i] = req;
+		if(n < cap) n++;
+	}
+	void operator()(omniscio_symbol next, double proba) {
+		if(not wanted(proba)) return;
+		omniscio_req req;
+		predict_request(next,proba,req);
+		keep(req);
+	}
+};
+
+/**
+ * Computes the predictions of the model for the next operations,
+ * _model_lock_ must be held.
+ * \param[out] result : predicted operations.
+ */
+static void predict(std::vector<omniscio_req>& result)
+{
+	// clearing keeps the memory for the next predictions
+	result.clear();
+	append_requests a(result);
+	_model_.for_each_prediction(a);
+}
+
 int predict_next(omniscio_req** prediction, int* n)
 {
-	if(_started_) {
+	if(_thread_ != NULL && _thread_->started) {
 		*n = 0;
 		return OMNISCIO_ERROR;
 	}
 
-	std::vector<std::pair<omniscio_symbol,double> > pred_sym;
-	_model_.predict(pred_sym);
-	*n = pred_sym.size();
+	std::vector<omniscio_req> result;
+	if(_async_) {
+		if(__atomic_load_n(&_publish_,__ATOMIC_ACQUIRE)) {
+			// last predictions of the consumer thread
+			pthread_mutex_lock(&_published_lock_);
+			result = _published_;
+			pthread_mutex_unlock(&_published_lock_);
+		} else {
+			// first request: the consumer publishes from now on
+			pthread_mutex_lock(&_threads_lock_);
+			pthread_mutex_lock(&_model_lock_);
+			drain();
+			predict(result);
+			__atomic_store_n(&_publish_,1,__ATOMIC_RELEASE);
+			pthread_mutex_unlock(&_model_lock_);
+			pthread_mutex_unlock(&_threads_lock_);
+		}
+	} else {
+		pthread_mutex_lock(&_model_lock_);
+		predict(result);
+		pthread_mutex_unlock(&_model_lock_);
+	}
+
+	*n = result.size();
 	*prediction = (omniscio_req*)malloc(sizeof(omniscio_req)*(*n));
+	if(*n > 0) std::copy(result.begin(),result.end(),*prediction);
+
+	return OMNISCIO_OK;
+}
 
-	std::vector<std::pair<omniscio_symbol,double> >::iterator it = 
-		pred_sym.begin();
-	for(int i=0; it != pred_sym.end(); it++, i++) {
-		omniscio_symbol next = it->first;
-		double proba = it->second;
-		// predict the size
-		size_t size = _size_table_(next).predict();
-		(*prediction)[i].size = size;
-		// predict the offset		
-		offset_op op = _offset_table_(_previous_sym_,next).predict();
-		omniscio_offset offset = op.get_offset_after(_previous_offset_,
-							     _previous_size_);
-		(*prediction)[i].offset = offset;
-		// predict the date
-		omniscio_date date = 
-			_time_table_(_previous_sym_,next).get_adapted();
-		(*prediction)[i].date = date;
-		// predict the type
-		omniscio_op_type type = _type_table_(next);
-		(*prediction)[i].type = type;
-		// set probability
-		(*prediction)[i].proba = proba;
+int predict_into(omniscio_req* buf, int cap, double threshold, int* n)
+{
+	if(n == NULL) return OMNISCIO_ERROR;
+	*n = 0;
+	if(cap < 0 || (buf == NULL && cap > 0)) return OMNISCIO_ERROR;
+	if(_thread_ != NULL && _thread_->started) return OMNISCIO_ERROR;
+
+	keep_requests k(buf,cap,threshold);
+	if(_async_ && __atomic_load_n(&_publish_,__ATOMIC_ACQUIRE)) {
+		// last predictions of the consumer thread
+		pthread_mutex_lock(&_published_lock_);
+		for(size_t i = 0; i < _published_.size(); i++)
+			k.keep(_published_[i]);
+		pthread_mutex_unlock(&_published_lock_);
+	} else if(_async_) {
+		// first request: the consumer publishes from now on
+		pthread_mutex_lock(&_threads_lock_);
+		pthread_mutex_lock(&_model_lock_);
+		drain();
+		_model_.for_each_prediction(k);
+		__atomic_store_n(&_publish_,1,__ATOMIC_RELEASE);
+		pthread_mutex_unlock(&_model_lock_);
+		pthread_mutex_unlock(&_threads_lock_);
+	} else {
+		pthread_mutex_lock(&_model_lock_);
+		_model_.for_each_prediction(k);
+		pthread_mutex_unlock(&_model_lock_);
 	}
+	*n = k.n;
 
 	return OMNISCIO_OK;
 }
@@ -447,45 +1785,53 @@ int omniscio_init(int* argc, char*** argv)
 	return omniscio::init(argc,argv);
 }
 
-int omniscio_open_start(const char* filename, omniscio_api_type t)
+int ENTRY_POINT omniscio_open_start(const char* filename, omniscio_api_type t)
 {
+	omniscio::profiled p(false);
 	return omniscio::open_start(filename,t);
 }
 
 int omniscio_open_end(int success, omniscio_file fh) 
 {
+	omniscio::profiled p(true);
 	return omniscio::open_end(success,fh);
 }
 
-int omniscio_close_start(omniscio_file fh)
+int ENTRY_POINT omniscio_close_start(omniscio_file fh)
 {
+	omniscio::profiled p(false);
 	return omniscio::close_start(fh);
 }
 
 int omniscio_close_end(int success)
 {
+	omniscio::profiled p(true);
 	return omniscio::close_end(success);
 }
 
-int omniscio_write_start(omniscio_file fh,
+int ENTRY_POINT omniscio_write_start(omniscio_file fh,
 	omniscio_offset offset, omniscio_size size)
 {
+	omniscio::profiled p(false);
 	return omniscio::write_start(fh,offset,size);
 }
 
 int omniscio_write_end(int success)
 {
+	omniscio::profiled p(true);
 	return omniscio::write_end(success);
 }
 
-int omniscio_read_start(omniscio_file fh,
+int ENTRY_POINT omniscio_read_start(omniscio_file fh,
 	omniscio_offset offset, omniscio_size size)
 {
+	omniscio::profiled p(false);
 	return omniscio::read_start(fh,offset,size);
 }
 
 int omniscio_read_end(int success)
 {
+	omniscio::profiled p(true);
 	return omniscio::read_end(success);
 }
 
@@ -510,11 +1856,39 @@ int omniscio_file_from_mpiio(omniscio_file* result, MPI_File fh)
 	return OMNISCIO_OK;
 }
 
+int omniscio_get_profile(omniscio_op_type op, omniscio_stage stage,
+		omniscio_profile* profile)
+{
+	return omniscio::get_profile(op,stage,profile);
+}
+
+int omniscio_get_percentile(omniscio_op_type op, omniscio_stage stage,
+		double percent, long long* ns)
+{
+	return omniscio::get_percentile(op,stage,percent,ns);
+}
+
+int omniscio_unify(void)
+{
+	return omniscio::unify();
+}
+
+int omniscio_get_stats(omniscio_stats* stats)
+{
+	return omniscio::get_stats(stats);
+}
+
 int omniscio_next(omniscio_req** prediction, int* n)
 {
 	return omniscio::predict_next(prediction,n);
 }
 
+int omniscio_next_into(omniscio_req* buf, int cap, double threshold,
+			int* n)
+{
+	return omniscio::predict_into(buf,cap,threshold,n);
+}
+
 int omniscio_free(omniscio_req* prediction)
 {
 	free(prediction);
@@ -35,6 +35,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <set>
+#include <pthread.h>
 #define __GNU_SOURCE
 #ifndef __USE_GNU
 #define __USE_GNU
@@ -43,12 +44,58 @@
 
 #include "omniscio.h"
 
-static std::set<int> allowed_fds;
-static std::set<FILE*> allowed_streams;
+/* Descriptors opened while tracing, one bit per descriptor so that the
+ * read/write wrappers can check them without taking any lock. Streams are
+ * kept in their own bitmap, keyed by their descriptor. Descriptors beyond
+ * MAX_ALLOWED_FD are rare and go to a set under allowed_lock. */
+#define MAX_ALLOWED_FD 65536
+#define ALLOWED_WORD_BITS (8*sizeof(unsigned long))
+#define ALLOWED_WORDS (MAX_ALLOWED_FD/ALLOWED_WORD_BITS)
+
+struct allowed_set {
+	unsigned long bits[ALLOWED_WORDS];
+	std::set<int> others;
+};
+
+static allowed_set allowed_fds;
+static allowed_set allowed_streams;
+static pthread_mutex_t allowed_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool is_allowed_in(allowed_set& s, int fd) {
+	if(fd < 0) return false;
+	if(fd < MAX_ALLOWED_FD) {
+		unsigned long w = __atomic_load_n(&s.bits[fd/ALLOWED_WORD_BITS],
+						__ATOMIC_ACQUIRE);
+		return (w >> (fd%ALLOWED_WORD_BITS)) & 1UL;
+	}
+	pthread_mutex_lock(&allowed_lock);
+	bool res = s.others.count(fd) != 0;
+	pthread_mutex_unlock(&allowed_lock);
+	return res;
+}
+
+static void allow_in(allowed_set& s, int fd, bool allow) {
+	if(fd < 0) return;
+	if(fd < MAX_ALLOWED_FD) {
+		unsigned long mask = 1UL << (fd%ALLOWED_WORD_BITS);
+		unsigned long* w = &s.bits[fd/ALLOWED_WORD_BITS];
+		if(allow) __atomic_fetch_or(w,mask,__ATOMIC_RELEASE);
+		else __atomic_fetch_and(w,~mask,__ATOMIC_RELEASE);
+		return;
+	}
+	pthread_mutex_lock(&allowed_lock);
+	if(allow) s.others.insert(fd);
+	else s.others.erase(fd);
+	pthread_mutex_unlock(&allowed_lock);
+}
 
-#define IS_ALLOWED_FD(fd) allowed_fds.count(fd)
+static int stream_fd(FILE* f) {
+	return f ? fileno_unlocked(f) : -1;
+}
+
+#define IS_ALLOWED_FD(fd) is_allowed_in(allowed_fds,fd)
 
-#define IS_ALLOWED_FILE(f) allowed_streams.count(f)
+#define IS_ALLOWED_FILE(f) is_allowed_in(allowed_streams,stream_fd(f))
 
 #define offset64_t __off64_t
 #define offset_t off_t
@@ -60,6 +107,12 @@ extern "C" {
 
 #define MAP_OR_FAIL(func) \
 	if(omniscio_tracing_enabled_p == 0) { \
+		/* the flag must be known before tracing is */ \
+		*(void**)(&omniscio_untraced_flag_p) \
+		= dlsym(RTLD_DEFAULT, "omniscio_untraced_flag"); \
+		if(omniscio_untraced_flag_p == 0) { \
+			omniscio_untraced_flag_p = &omniscio_untraced_local; \
+		} \
 		omniscio_tracing_enabled_p \
 		= dlsym(RTLD_DEFAULT, "omniscio_tracing_enabled"); \
 		if(omniscio_tracing_enabled_p == 0) { \
@@ -72,7 +125,7 @@ extern "C" {
 			 &omniscio_tracing_disabled)) { \
 		_libc_ ## func = dlsym(RTLD_NEXT, #func); \
 		if(!(_libc_ ## func)) { \
-			omniscio_tracing_enabled = 0; \
+			*omniscio_tracing_enabled_p = 0; \
 			fprintf(stderr, "Failed to map symbol: %s\n", #func); \
 			exit(1); \
 		} \
@@ -80,7 +133,15 @@ extern "C" {
 
 int* omniscio_tracing_enabled_p;
 int omniscio_tracing_disabled = 0;
-#define omniscio_tracing_enabled *omniscio_tracing_enabled_p
+#define omniscio_tracing_enabled (*omniscio_tracing_enabled_p \
+	&& !omniscio_untraced)
+
+static __thread int omniscio_untraced_value = 0;
+static int* omniscio_untraced_local(void) {
+	return &omniscio_untraced_value;
+}
+int* (*omniscio_untraced_flag_p)(void) = NULL;
+#define omniscio_untraced (*omniscio_untraced_flag_p())
 
 FORWARD_DECL(open64, int, (const char *path, int flags, ...))
 FORWARD_DECL(open, int, (const char *path, int flags, ...))
@@ -115,7 +176,7 @@ FILE *fopen(const char *path, const char *mode)
 		omniscio_file ofile;
 		omniscio_file_from_libc(&ofile,result);
 		omniscio_open_end((result != 0 ? 0 : -1),ofile);
-		allowed_streams.insert(result);
+		allow_in(allowed_streams,stream_fd(result),true);
 		OMNISCIO_UNTRACED_END;
 		return result;
 	} else {
@@ -137,7 +198,7 @@ FILE *fopen64(const char *path, const char *mode)
 		omniscio_file ofile;
 		omniscio_file_from_libc(&ofile,result);
 		omniscio_open_end((result != 0 ? 0 : -1),ofile);
-		allowed_streams.insert(result);
+		allow_in(allowed_streams,stream_fd(result),true);
 		OMNISCIO_UNTRACED_END;
 		return result;
 	} else {
@@ -168,7 +229,7 @@ int open(const char *pathname, int flags, ...)
 		omniscio_file ofile;
 		omniscio_file_from_posix(&ofile,result);
 		omniscio_open_end((result != -1 ? 0 : -1),ofile);
-		allowed_fds.insert(result);
+		allow_in(allowed_fds,result,true);
 		OMNISCIO_UNTRACED_END;
 		return result;
 	} else {
@@ -207,7 +268,7 @@ int open64(const char *pathname, int flags, ...)
 		omniscio_file ofile;
 		omniscio_file_from_posix(&ofile,result);
 		omniscio_open_end((result != -1 ? 0 : -1),ofile);
-		allowed_fds.insert(result);
+		allow_in(allowed_fds,result,true);
 		OMNISCIO_UNTRACED_END;
 		return result;
 	} else {
@@ -237,7 +298,7 @@ int creat(const char* path, mode_t mode)
 		omniscio_file ofile;
 		omniscio_file_from_posix(&ofile,result);
 		omniscio_open_end((result != -1 ? 0 : -1),ofile);
-		allowed_fds.insert(result);
+		allow_in(allowed_fds,result,true);
 		OMNISCIO_UNTRACED_END;
 		return result;
 	} else {
@@ -259,7 +320,7 @@ int creat64(const char* path, mode_t mode)
 		omniscio_file ofile;
 		omniscio_file_from_posix(&ofile,result);
 		omniscio_open_end((result != -1 ? 0 : -1),ofile);
-		allowed_fds.insert(result);
+		allow_in(allowed_fds,result,true);
 		OMNISCIO_UNTRACED_END;
 		return result;
 	} else {
@@ -439,9 +500,11 @@ int fclose(FILE* stream)
 		omniscio_file ofile;
 		omniscio_file_from_libc(&ofile,stream);
 		omniscio_close_start(ofile);
+		/* cleared before closing: the stream is gone afterwards and
+		 * its descriptor may be reused by another thread */
+		allow_in(allowed_streams,stream_fd(stream),false);
 		int result = _libc_fclose(stream);
 		omniscio_close_end(result);
-		allowed_streams.erase(stream);
 		OMNISCIO_UNTRACED_END;
 		return result;
 	} else {
@@ -461,9 +524,9 @@ int close(int fd)
 		omniscio_file ofile;
 		omniscio_file_from_posix(&ofile,fd);
 		omniscio_close_start(ofile);
+		allow_in(allowed_fds,fd,false);
 		int result = _libc_close(fd);
 		omniscio_close_end(result);
-		allowed_fds.erase(fd);
 		OMNISCIO_UNTRACED_END;
 		return result;
 	} else {
@@ -0,0 +1,136 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef OMNISCIO_RING_H
+#define OMNISCIO_RING_H
+
+#include <cstddef>
+#include <cstdlib>
+
+namespace omniscio {
+
+/**
+ * The ring class is a bounded queue of T for exactly one producer
+ * thread and one consumer thread. It does not lock: the producer only
+ * writes the tail and the consumer only writes the head, each publishing
+ * its progress with a release store that the other reads with an acquire
+ * load. The capacity is rounded up to a power of 2 and the storage is
+ * allocated once, so that push never allocates.
+ */
+template<typename T>
+class ring {
+
+	private:
+
+	T*	items;
+	size_t	mask;
+	// head and tail on their own cache lines
+	char	pad0[64];
+	size_t	head;	// next item to pop, written by the consumer
+	char	pad1[64];
+	size_t	tail;	// next item to push, written by the producer
+	char	pad2[64];
+
+	ring(const ring&);
+	ring& operator=(const ring&);
+
+	public:
+
+	/**
+	 * Constructor for a ring without storage, see reserve.
+	 */
+	ring() : items(NULL), mask(0), head(0), tail(0) {}
+
+	/**
+	 * Destructor.
+	 */
+	~ring() {
+		delete[] items;
+	}
+
+	/**
+	 * Allocates the storage, must be called before any thread uses
+	 * the ring.
+	 * \param[in] capacity : number of items, rounded up to a power of 2.
+	 */
+	void reserve(size_t capacity) {
+		size_t c = 2;
+		while(c < capacity) c <<= 1;
+		delete[] items;
+		items = new T[c];
+		mask = c-1;
+		head = tail = 0;
+	}
+
+	/**
+	 * Returns the number of items the ring can hold.
+	 */
+	size_t capacity() const {
+		return items == NULL ? 0 : mask+1;
+	}
+
+	/**
+	 * Producer side: copies an item at the end of the ring.
+	 * \param[in] item : item to push.
+	 * \return false if the ring is full, in which case it is unchanged.
+	 */
+	bool push(const T& item) {
+		size_t t = tail;
+		if(t - __atomic_load_n(&head,__ATOMIC_ACQUIRE) > mask)
+			return false;
+		items[t & mask] = item;
+		__atomic_store_n(&tail,t+1,__ATOMIC_RELEASE);
+		return true;
+	}
+
+	/**
+	 * Consumer side: removes the item at the beginning of the ring.
+	 * \param[out] item : item popped.
+	 * \return false if the ring is empty.
+	 */
+	bool pop(T& item) {
+		size_t h = head;
+		if(h == __atomic_load_n(&tail,__ATOMIC_ACQUIRE))
+			return false;
+		item = items[h & mask];
+		__atomic_store_n(&head,h+1,__ATOMIC_RELEASE);
+		return true;
+	}
+
+	/**
+	 * Returns the number of items in the ring. Exact from either
+	 * side when the other one is idle, a snapshot otherwise.
+	 */
+	size_t size() const {
+		return __atomic_load_n(&tail,__ATOMIC_ACQUIRE)
+			- __atomic_load_n(&head,__ATOMIC_ACQUIRE);
+	}
+};
+
+}
+
+#endif
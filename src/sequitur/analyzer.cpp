@@ -31,6 +31,14 @@
 #include <cstdlib>
 #include <list>
 #include <set>
+#include <map>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <glob.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <mpi.h>
 
 #include "matrix.hpp"
@@ -38,6 +46,7 @@
 #include "sizes.hpp"
 #include "offsets.hpp"
 #include "stats/adaptive_stats.hpp"
+#include "logreader.hpp"
 #include "oracle.hpp"
 
 #define START_TIMER(name)\
@@ -52,37 +61,76 @@
 using namespace omniscio;
 using namespace omniscio::sequitur;
 
-static matrix<adaptive_stats<double> > _trans_stats_;
-static vector<size_tracker> _size_stats_;
-static matrix<offset_tracker> _offset_stats_;
-static std::map<unsigned long long,size_t> _offset_tracker_;
-static double _previous_date_ = 0.0;
-static int _previous_sym_ = 0;
-static long _previous_offset_ = 0;
-static size_t _previous_size_ = 0;
-
-int main(int argc, char** argv)
+/**
+ * Results of the analysis of one trace.
+ */
+struct analysis {
+	std::string	input;		// trace to analyze
+	std::string	output;		// per-operation results (empty = stdout)
+	bool		ok;		// false if the trace could not be read
+	long		operations;	// number of operations in the trace
+	double		accuracy;	// cumulative symbol prediction (%)
+	size_t		grammar_size;	// final number of symbols in the grammar
+	long		rules;		// final number of rules in the grammar
+	double		time;		// time spent analyzing the trace (s)
+	int		max_depth;	// bound on the depth of the grammar
+
+	analysis(const std::string& i = "", const std::string& o = "",
+		int d = 0)
+	: input(i), output(o), ok(false), operations(0), accuracy(0.0),
+	  grammar_size(0), rules(0), time(0.0), max_depth(d) {}
+};
+
+/**
+ * Replays a trace through a fresh oracle and trackers, writing the
+ * per-operation results and filling the summary fields of a.
+ * Everything is local to the call, so several traces can be
+ * analyzed concurrently.
+ */
+static void analyze(analysis& a)
 {
-	if(argc < 2) {
-		std::cerr << "Usage: ./sequitur file" << std::endl;
-		exit(0);
+	START_TIMER(total_timer);
+
+	matrix<adaptive_stats<double> > _trans_stats_;
+	vector<size_tracker> _size_stats_;
+	matrix<offset_tracker> _offset_stats_;
+	std::map<unsigned long long,size_t> _offset_tracker_;
+	double _previous_date_ = 0.0;
+	int _previous_sym_ = 0;
+	long _previous_offset_ = 0;
+	size_t _previous_size_ = 0;
+
+	// logs in any OMNISCIO_LOG_FORMAT, or older text traces
+	log_reader reader;
+	if(not reader.open(a.input)) {
+		std::cerr << "Unable to read " << a.input << std::endl;
+		return;
 	}
-	
-	MPI_Init(&argc,&argv);
 
-	std::ifstream ifs(argv[1], std::ifstream::in);
+	std::ofstream file;
+	if(not a.output.empty()) {
+		file.open(a.output.c_str());
+		if(not file.is_open()) {
+			std::cerr << "Unable to create " << a.output << std::endl;
+			return;
+		}
+	}
+	std::ostream& out = a.output.empty() ? std::cout : file;
+
+	event e;
 
 	oracle o;
+	o.set_max_depth(a.max_depth);
 	
-	double ts, start, end;
-	int sym, op, api, ret;
+	double start, end;
+	int sym, op;
 	long offset;
 	long size;
 	unsigned long long fd;
 
 
 #ifdef OUTPUT_OK
-	std::cout << "symbol, grammar_size, update_time, "
+	out << "symbol, grammar_size, update_time, "
 		  << "symbol_prediction(%%), cumulative_prediction(%%), "
 		  << "size_error, offset_error, real_time, predicted_time"
 		  << std::endl;
@@ -94,17 +142,14 @@ int main(int argc, char** argv)
 	long _num_operations_ = 0;
 
 	while (1) {
-		ifs >> ts;
-		ifs >> sym;
-		ifs >> op;
-		ifs >> api;
-		ifs >> offset;
-		ifs >> size;
-		ifs >> start;
-		ifs >> end;
-		ifs >> fd;
-		ifs >> ret;
-		if (ifs.eof()) break;
+		if(not reader.next(e)) break;
+		sym = e.sym;
+		op = e.op;
+		offset = e.offset;
+		size = e.size;
+		start = e.start;
+		end = e.end;
+		fd = e.fd;
 
 ////////////////////////////////////////////////////////////////////////////////
 ///////////////// ANALYSIS OF PREDICTION PERFORMANCE ///////////////////////////
@@ -239,7 +284,7 @@ int main(int argc, char** argv)
 ///////////////// PRINTING RESULTS /////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 #ifdef OUTPUT_OK
-		std::cout << sym << ",\t" << o.size() << ",\t"
+		out << sym << ",\t" << o.size() << ",\t"
 			  << std::fixed << std::setprecision(6) 
 			  << update_timer << ",\t" 
 			  << std::setprecision(2) << pred_percent << ",\t" 
@@ -280,8 +325,216 @@ int main(int argc, char** argv)
 		_previous_date_ = end;
 	}
 
-	ifs.close();
+	const oracle::statistics& st = o.get_statistics();
+	a.operations	= _num_operations_;
+	a.accuracy	= _total_prediction_;
+	a.grammar_size	= o.size();
+	a.rules		= st.rules_created - st.rules_destroyed;
+	a.ok		= true;
 
-	MPI_Finalize();
+	END_TIMER(total_timer);
+	a.time = total_timer;
+}
+
+/**
+ * Work shared by the analysis threads: each thread picks the
+ * next trace not yet analyzed until none is left.
+ */
+struct work {
+	std::vector<analysis>*	jobs;
+	size_t			next;
+};
+
+static void* worker(void* arg)
+{
+	work* w = (work*)arg;
+	while(1) {
+		size_t i = __sync_fetch_and_add(&(w->next),1);
+		if(i >= w->jobs->size()) break;
+		analyze((*(w->jobs))[i]);
+	}
+	return NULL;
+}
+
+// value at quantile q (0 <= q <= 1) of a sorted vector
+template<typename T>
+static T percentile(const std::vector<T>& v, double q)
+{
+	if(v.empty()) return T();
+	size_t i = (size_t)(q*(v.size()-1) + 0.5);
+	return v[i];
+}
+
+template<typename T>
+static void print_distribution(const char* name, std::vector<T>& v)
+{
+	std::sort(v.begin(),v.end());
+	double mean = 0.0;
+	for(size_t i = 0; i < v.size(); i++) mean += v[i];
+	if(not v.empty()) mean /= v.size();
+	std::cout << name << ": "
+		  << "min " << percentile(v,0.0)
+		  << ", p10 " << percentile(v,0.10)
+		  << ", p25 " << percentile(v,0.25)
+		  << ", median " << percentile(v,0.5)
+		  << ", p75 " << percentile(v,0.75)
+		  << ", p90 " << percentile(v,0.90)
+		  << ", max " << percentile(v,1.0)
+		  << ", mean " << mean << std::endl;
+}
+
+static void usage(const char* name)
+{
+	std::cerr << "Usage: " << name
+		  << " [-j threads] [-o directory] [-d depth] trace..."
+		  << std::endl
+		  << "  -d bounds the depth of the grammar (0: unbounded)."
+		  << std::endl
+		  << "  traces can be given as glob patterns (e.g. 'omniscio.*.log')."
+		  << std::endl
+		  << "  With a single trace the results are printed on the standard"
+		  << std::endl
+		  << "  output, otherwise each trace gets a <trace>.csv file in the"
+		  << std::endl
+		  << "  output directory (<trace>.<index>.csv if several traces have"
+		  << std::endl
+		  << "  the same name) and a summary is printed." << std::endl;
 }
 
+int main(int argc, char** argv)
+{
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	std::string outdir;
+	int depth = 0;
+	int c;
+	while((c = getopt(argc,argv,"j:o:d:h")) != -1) {
+		switch(c) {
+		case 'j':
+			threads = std::atoi(optarg);
+			break;
+		case 'o':
+			outdir = optarg;
+			break;
+		case 'd':
+			depth = std::atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			exit(0);
+		}
+	}
+	if(optind >= argc) {
+		usage(argv[0]);
+		exit(0);
+	}
+	if(threads < 1) threads = 1;
+
+	std::vector<std::string> inputs;
+	for(int i = optind; i < argc; i++) {
+		if(std::strpbrk(argv[i],"*?[") == NULL) {
+			inputs.push_back(argv[i]);
+			continue;
+		}
+		glob_t g;
+		if(glob(argv[i],0,NULL,&g) == 0) {
+			for(size_t j = 0; j < g.gl_pathc; j++)
+				inputs.push_back(g.gl_pathv[j]);
+		} else {
+			std::cerr << "No trace matching " << argv[i] << std::endl;
+		}
+		globfree(&g);
+	}
+	if(inputs.empty()) exit(1);
+
+	int provided;
+	MPI_Init_thread(&argc,&argv,MPI_THREAD_MULTIPLE,&provided);
+	// the threads of the pool time their work with MPI_Wtime
+	if(provided < MPI_THREAD_MULTIPLE && threads > 1) {
+		std::cerr << "MPI does not support threads, "
+			  << "analyzing the traces one at a time" << std::endl;
+		threads = 1;
+	}
+
+	// traces of different directories may have the same name
+	// (e.g. run*/omniscio.*.0.log), their files get the index of
+	// the trace so that no two threads write the same file.
+	std::vector<std::string> bases;
+	std::map<std::string,int> count;
+	for(size_t i = 0; i < inputs.size(); i++) {
+		std::string base = inputs[i];
+		size_t slash = base.rfind('/');
+		if(slash != std::string::npos) base = base.substr(slash+1);
+		bases.push_back(base);
+		count[base] += 1;
+	}
+
+	std::vector<analysis> jobs;
+	bool single = (inputs.size() == 1) && outdir.empty();
+	for(size_t i = 0; i < inputs.size(); i++) {
+		std::string output;
+		if(not single) {
+			std::stringstream ss;
+			ss << (outdir.empty() ? std::string(".") : outdir)
+			   << "/" << bases[i];
+			if(count[bases[i]] > 1) ss << "." << i;
+			ss << ".csv";
+			output = ss.str();
+		}
+		jobs.push_back(analysis(inputs[i],output,depth));
+	}
+
+	if((size_t)threads > jobs.size()) threads = jobs.size();
+
+	START_TIMER(wall_timer);
+	work w;
+	w.jobs = &jobs;
+	w.next = 0;
+	std::vector<pthread_t> pool(threads-1);
+	size_t started = 0;
+	for(; started < pool.size(); started++) {
+		if(pthread_create(&pool[started],NULL,worker,&w) != 0) {
+			std::cerr << "Could only start " << started+1
+				  << " thread(s)" << std::endl;
+			break;
+		}
+	}
+	threads = started+1;
+	worker(&w);
+	for(size_t i = 0; i < started; i++) {
+		pthread_join(pool[i],NULL);
+	}
+	END_TIMER(wall_timer);
+
+	if(not single) {
+		std::vector<double> accuracy;
+		std::vector<size_t> grammar;
+		std::vector<long> rules;
+		double cpu_time = 0.0;
+		std::cout << "trace, operations, accuracy(%), grammar_size, rules, time"
+			  << std::endl;
+		for(size_t i = 0; i < jobs.size(); i++) {
+			const analysis& a = jobs[i];
+			if(not a.ok) continue;
+			std::cout << a.input << ",\t" << a.operations << ",\t"
+				  << std::fixed << std::setprecision(2)
+				  << a.accuracy << ",\t" << a.grammar_size << ",\t"
+				  << a.rules << ",\t" << std::setprecision(6)
+				  << a.time << std::endl;
+			accuracy.push_back(a.accuracy);
+			grammar.push_back(a.grammar_size);
+			rules.push_back(a.rules);
+			cpu_time += a.time;
+		}
+		std::cout << std::endl << "traces: " << accuracy.size()
+			  << "/" << jobs.size() << " analyzed with "
+			  << threads << " thread(s) in " << wall_timer
+			  << " s (" << cpu_time << " s of analysis)" << std::endl;
+		std::cout << std::setprecision(2);
+		print_distribution("accuracy(%)",accuracy);
+		print_distribution("grammar_size",grammar);
+		print_distribution("rules",rules);
+	}
+
+	MPI_Finalize();
+	return 0;
+}
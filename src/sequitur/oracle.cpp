@@ -36,13 +36,23 @@
 #include <cstdlib>
 #include <cstdio>
 #include <unistd.h>
+#include <time.h>
+#include <algorithm>
 #include "oracle.hpp"
 
 namespace omniscio {
 namespace sequitur {
 
+static inline long long now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (long long)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
 void oracle::find_new_predictors(symbols* s) 
 {
+	stats.predictor_searches++;
 	std::set<rules*>::iterator it = rules_set.begin();
 	for(;it != rules_set.end(); it++) {
 		rules* r = *it;
@@ -50,22 +60,317 @@ void oracle::find_new_predictors(symbols* s)
 	}
 }
 
+void oracle::update_predictors()
+{
+	promoted.clear();
+	root->update_predictors(promoted);
+	for(size_t i = 0; i < promoted.size(); i++) {
+		promoted[i]->become_predictor_down_left();
+	}
+}
+
 void oracle::input(int x) {
+	long long t = now_ns();
+	stats.inputs++;
+
+	if(freeze_window > 0 && not lazy) {
+		record_hit(predicts(x));
+		if(frozen) {
+			follow(x);
+			stats.frozen_inputs++;
+			stats.input_time += now_ns() - t;
+			return;
+		}
+	}
+
 	version++;
 
 	symbols* s = new symbols(x,start);
 	start->last()->insert_after(s);
 
+	if(lazy) {
+		pending.push_back(x);
+		if(pending.size() > window) pending.pop_front();
+		stale = true;
+		start->last()->prev()->check();
+		stats.input_time += now_ns() - t;
+		return;
+	}
+
 	root->compute_next_predictors(s);
-	root->update_predictors();
+	update_predictors();
 	start->last()->prev()->check();
 	
 	if(! root->is_pred()) {
+		// check() may have substituted (and deleted) s,
+		// so the predictors are matched against a copy.
+		symbols last(x);
 		find_new_predictors(start->last());
+		root->compute_next_predictors(&last);
+		update_predictors();
+	}
+
+	stats.input_time += now_ns() - t;
+}
+
+void oracle::set_lazy(bool l, size_t w)
+{
+	window = w;
+	if(l == lazy) return;
+	lazy = l;
+	// predictors are restarted from an empty context in both
+	// directions: lazy mode replays what it records from now on,
+	// eager mode finds a new context on the next input.
+	pending.clear();
+	reset_predictors();
+	stale = false;
+}
+
+void oracle::set_freeze(size_t n, double t)
+{
+	long long now = now_ns();
+	if(freeze_window > 0) mode_time[frozen] += now - mode_start;
+	mode_start = now;
+	frozen = false;
+	freeze_window = n;
+	freeze_threshold = t;
+	hits.assign(n,0);
+	hits_pos = hits_count = hits_seen = 0;
+}
+
+bool oracle::predicts(int x) const
+{
+	std::set<symbols*>::const_iterator it = predictions.begin();
+	for(; it != predictions.end(); it++) {
+		if(not (*it)->nt() && (*it)->value() == (ulong)x)
+			return true;
+	}
+	return false;
+}
+
+bool oracle::predicted_before(std::set<symbols*>::const_iterator it) const
+{
+	ulong x = (*it)->value();
+	std::set<symbols*>::const_iterator p = predictions.begin();
+	for(; p != it; p++) {
+		if(not (*p)->nt() && (*p)->value() == x) return true;
+	}
+	return false;
+}
+
+void oracle::record_hit(bool hit)
+{
+	if(hits_seen == freeze_window) hits_count -= hits[hits_pos];
+	else hits_seen++;
+	hits[hits_pos] = hit;
+	hits_count += hit;
+	hits_pos = (hits_pos+1) % freeze_window;
+
+	bool stable = hits_seen == freeze_window
+		&& hits_count >= freeze_threshold*freeze_window;
+	if(stable == frozen) return;
+
+	long long now = now_ns();
+	mode_time[frozen] += now - mode_start;
+	mode_start = now;
+	frozen = stable;
+	if(frozen) {
+		stats.freezes++;
+	} else {
+		// the rate has to be earned again before freezing
+		std::fill(hits.begin(),hits.end(),0);
+		hits_pos = hits_count = hits_seen = 0;
+	}
+}
+
+void oracle::follow(int x)
+{
+	// the symbol is not part of the grammar, as in rebuild_predictors
+	symbols s(x);
+	step_predictors(&s);
+}
+
+const oracle::statistics& oracle::get_statistics()
+{
+	stats.digrams = table.size();
+	stats.predictors = predictions.size();
+	stats.learning_time = mode_time[0];
+	stats.frozen_time = mode_time[1];
+	if(freeze_window > 0) {
+		long long now = now_ns();
+		if(frozen) stats.frozen_time += now - mode_start;
+		else stats.learning_time += now - mode_start;
+	}
+	return stats;
+}
+
+void oracle::step_predictors(symbols* s)
+{
+	root->compute_next_predictors(s);
+	update_predictors();
+	if(! root->is_pred()) {
+		find_new_predictors(s);
 		root->compute_next_predictors(s);
-		root->update_predictors();
+		update_predictors();
 	}
+}
 
+void oracle::reset_predictors()
+{
+	std::set<rules*>::iterator it = rules_set.begin();
+	for(; it != rules_set.end(); it++) {
+		symbols* s = (*it)->first();
+		for(; not s->is_guard(); s = s->next())
+			s->reset_predictor();
+	}
+	root->reset_predictor();
+	predictions.clear();
+}
+
+void oracle::rebuild_predictors()
+{
+	stats.rebuilds++;
+	reset_predictors();
+	std::deque<int>::iterator it = pending.begin();
+	for(; it != pending.end(); it++) {
+		// the symbol is not part of the grammar, so
+		// it cannot be mistaken for one of its occurrences.
+		symbols s(*it);
+		step_predictors(&s);
+	}
+	stale = false;
+}
+
+void oracle::set_max_depth(int d)
+{
+	bool enable = (max_depth == 0) && (d > 0);
+	bool disable = (max_depth != 0) && (d <= 0);
+	max_depth = d > 0 ? d : 0;
+	if(disable) {
+		std::set<rules*>::iterator it = rules_set.begin();
+		for(; it != rules_set.end(); it++)
+			(*it)->get_parents().clear();
+	}
+	if(not enable) return;
+	// depths and parents are not maintained while the grammar is
+	// unbounded, rules are sorted so that they are computed after
+	// their content.
+	std::vector<rules*> order;
+	std::set<rules*> done;
+	std::vector<std::pair<rules*,symbols*> > stack;
+	std::set<rules*>::iterator it = rules_set.begin();
+	for(; it != rules_set.end(); it++) {
+		for(symbols* s = (*it)->first(); not s->is_guard(); s = s->next())
+			if(s->nt()) s->rule()->add_parent(*it);
+		if(done.count(*it)) continue;
+		done.insert(*it);
+		stack.push_back(std::make_pair(*it,(*it)->first()));
+		while(not stack.empty()) {
+			symbols* c = stack.back().second;
+			if(c->is_guard()) {
+				order.push_back(stack.back().first);
+				stack.pop_back();
+				continue;
+			}
+			stack.back().second = c->next();
+			if(c->nt() && done.count(c->rule()) == 0) {
+				done.insert(c->rule());
+				stack.push_back(std::make_pair(c->rule(),
+							c->rule()->first()));
+			}
+		}
+	}
+	for(size_t i = 0; i < order.size(); i++) {
+		compute_depth(order[i]);
+	}
+}
+
+void oracle::compute_depth(rules* r)
+{
+	int d = 0;
+	for(symbols* s = r->first(); not s->is_guard(); s = s->next()) {
+		if(depth_of(s) > d) d = depth_of(s);
+	}
+	r->depth(d+1);
+}
+
+bool oracle::can_raise_depth(rules* r, int d)
+{
+	std::set<rules*> current;
+	current.insert(r);
+	for(; not current.empty(); d++) {
+		std::set<rules*> next;
+		std::set<rules*>::iterator it = current.begin();
+		for(; it != current.end(); it++) {
+			if(*it == start || d <= (*it)->depth()) continue;
+			if(d > max_depth) return false;
+			std::map<rules*,int>& parents = (*it)->get_parents();
+			std::map<rules*,int>::iterator p = parents.begin();
+			for(; p != parents.end(); p++)
+				next.insert(p->first);
+		}
+		current.swap(next);
+	}
+	return true;
+}
+
+void oracle::raise_depth(rules* r, int d)
+{
+	if(r == start || d <= r->depth()) return;
+	r->depth(d);
+	std::map<rules*,int>& parents = r->get_parents();
+	std::map<rules*,int>::iterator p = parents.begin();
+	for(; p != parents.end(); p++)
+		raise_depth(p->first, d+1);
+}
+
+bool oracle::can_match(symbols* s, symbols* m)
+{
+	if(max_depth == 0) return true;
+	int d;
+	if(m->prev()->is_guard() && m->next()->next()->is_guard()) {
+		// the rule already exists, only the owner of s changes.
+		d = m->prev()->rule()->depth();
+	} else {
+		d = 1 + std::max(depth_of(s),depth_of(s->next()));
+		if(d > max_depth
+		|| not can_raise_depth(m->get_owner(),d+1)) {
+			stats.refusals++;
+			return false;
+		}
+	}
+	if(not can_raise_depth(s->get_owner(),d+1)) {
+		stats.refusals++;
+		return false;
+	}
+	return true;
+}
+
+void oracle::remap(const std::vector<int>& m)
+{
+	std::set<rules*>::iterator it;
+	for(it = rules_set.begin(); it != rules_set.end(); it++) {
+		for(symbols* s = (*it)->first(); not s->is_guard(); s = s->next()) {
+			if(not s->nt() && s->value() < m.size())
+				s->set_value(m[s->value()]);
+		}
+	}
+
+	// the digrams are indexed by value, the first occurrence
+	// of each one is indexed again
+	table.clear();
+	for(it = rules_set.begin(); it != rules_set.end(); it++) {
+		for(symbols* s = (*it)->first(); not s->is_guard(); s = s->next()) {
+			if(not s->next()->is_guard() && find_digram(s) == 0)
+				set_digram(s);
+		}
+	}
+
+	std::deque<int>::iterator p = pending.begin();
+	for(; p != pending.end(); p++) {
+		if(*p >= 0 && (size_t)*p < m.size()) *p = m[*p];
+	}
+	version += 1;
 }
 
 symbols* oracle::find_digram(symbols* s) {	
@@ -135,7 +440,8 @@ std::list<std::stack<symbols*> >
 	return result;
 }
 
-std::list<oracle::iterator> oracle::predict_all() const {
+std::list<oracle::iterator> oracle::predict_all() {
+	if(stale) rebuild_predictors();
 	std::list<std::stack<symbols*> > stacks = 
 		build_predictor_stack_from(root);
 	std::list<oracle::iterator> result;
@@ -154,6 +460,31 @@ std::list<oracle::iterator> oracle::predict_all() const {
 	return result;
 }
 
+void oracle::export_rules(std::vector<std::vector<ulong> >& out) const
+{
+	std::map<rules*,ulong> index;
+	std::vector<rules*> order;
+	index[start] = 0;
+	order.push_back(start);
+	for(size_t i = 0; i < order.size(); i++) {
+		std::vector<ulong> content;
+		for(symbols* s = order[i]->first(); !s->is_guard(); s = s->next()) {
+			if(not s->nt()) {
+				content.push_back(s->value()*2+1);
+				continue;
+			}
+			std::map<rules*,ulong>::iterator it = index.find(s->rule());
+			if(it == index.end()) {
+				it = index.insert(std::make_pair(s->rule(),
+						(ulong)order.size())).first;
+				order.push_back(s->rule());
+			}
+			content.push_back(it->second*2);
+		}
+		out.push_back(content);
+	}
+}
+
 void oracle::print_rule(std::ostream& stream, rules* r) {
 	for (symbols *s = r->first(); !s->is_guard(); s = s->next()) {
 
@@ -36,10 +36,13 @@
 #define SEQUITUR_ORACLE_H
 
 #include <iostream>
+#include <cstring>
 #include <set>
 #include <list>
 #include <map>
 #include <stack>
+#include <deque>
+#include <vector>
 #include "rules.hpp"
 #include "symbols.hpp"
 
@@ -48,6 +51,32 @@ namespace sequitur {
 
 class oracle {
 
+	public:
+
+	/**
+	 * Counters describing the work done by the grammar engine.
+	 * digrams and predictors are snapshots taken when calling
+	 * get_statistics(), the other fields are cumulative.
+	 */
+	struct statistics {
+		long rules_created;
+		long rules_destroyed;
+		long matches;
+		long substitutions;
+		long expansions;
+		long digrams;		// current size of the digram table
+		long predictors;	// current number of active predictions
+		long predictor_searches;// calls to find_new_predictors
+		long inputs;		// calls to input
+		long long input_time;	// cumulative time spent in input (ns)
+		long rebuilds;		// predictor rebuilds done in lazy mode
+		long refusals;		// matches refused by the depth bound
+		long freezes;		// switches to the frozen mode
+		long frozen_inputs;	// inputs followed but not learned
+		long long learning_time;// time spent in the learning mode (ns)
+		long long frozen_time;	// time spent in the frozen mode (ns)
+	};
+
 	private:
 
 	friend class symbols;
@@ -59,13 +88,90 @@ class oracle {
 	symbols* root;
 
 	std::set<symbols*> predictions;
+	// symbols promoted by update_predictors, kept to reuse its storage
+	std::vector<symbols*> promoted;
 
 	rules** R;
 	int Ri;
 	int64_t version; // number of modifications performed
 
+	statistics stats;
+
+	// lazy mode: input() only updates the grammar and remembers
+	// the last window symbols, predictors are rebuilt from them
+	// the next time a prediction is requested.
+	bool lazy;
+	size_t window;
+	bool stale;
+	std::deque<int> pending;
+
+	// maximum depth of the rules other than the start rule
+	// (0 if the depth is not bounded).
+	int max_depth;
+
+	// freeze mode: once freeze_threshold of the last freeze_window
+	// inputs were predicted, input() stops growing the grammar and
+	// only moves the predictors forward, until the hit rate falls
+	// below the threshold again.
+	size_t freeze_window;
+	double freeze_threshold;
+	std::vector<char> hits;	// last inputs, 1 if they were predicted
+	size_t hits_pos;
+	size_t hits_count;
+	size_t hits_seen;
+	bool frozen;
+	long long mode_start;	// date of the last switch (ns)
+	long long mode_time[2];	// time spent learning and frozen (ns)
+
+	// returns true if x is among the terminals currently predicted.
+	bool predicts(int x) const;
+
+	// records whether the input was predicted and switches
+	// between learning and frozen mode accordingly.
+	void record_hit(bool hit);
+
+	// moves the predictors forward with x without adding it
+	// to the grammar.
+	void follow(int x);
+
+	// returns true if a terminal before it in predictions has
+	// the same value.
+	bool predicted_before(std::set<symbols*>::const_iterator it) const;
+
 	void find_new_predictors(symbols* s);
 
+	// depth of a symbol: 0 for terminals, depth of its rule otherwise.
+	int depth_of(symbols* s) {
+		return s->nt() ? s->rule()->depth() : 0;
+	}
+
+	// recomputes the depth of r from its content.
+	void compute_depth(rules* r);
+
+	// checks that the depth of r can become d without any rule
+	// going beyond max_depth.
+	bool can_raise_depth(rules* r, int d);
+
+	// sets the depth of r to at least d, propagating to the
+	// rules that use r.
+	void raise_depth(rules* r, int d);
+
+	// returns true if the digram starting at s can be replaced
+	// by a rule matching the digram starting at m.
+	bool can_match(symbols* s, symbols* m);
+
+	// makes the predictors computed by compute_next_predictors
+	// the current ones.
+	void update_predictors();
+
+	// moves the predictors forward with the symbol s, looking for
+	// a new context if none of them predicted it.
+	void step_predictors(symbols* s);
+
+	void reset_predictors();
+
+	void rebuild_predictors();
+
 	int get_num_rules() const {
 		return rules_set.size();
 	}
@@ -92,9 +198,20 @@ class oracle {
 	public:
 
 	oracle() {
+		std::memset(&stats,0,sizeof(stats));
 		start = new rules(this);
 		root = new symbols(start);
 		version = 0;
+		lazy = false;
+		window = 0;
+		stale = false;
+		max_depth = 0;
+		freeze_window = 0;
+		freeze_threshold = 1.0;
+		hits_pos = hits_count = hits_seen = 0;
+		frozen = false;
+		mode_start = 0;
+		mode_time[0] = mode_time[1] = 0;
 	}
 
 	~oracle() {
@@ -104,7 +221,65 @@ class oracle {
 
 	void input(int x);
 
-	std::set<int> predict_next() const {
+	/**
+	 * Switches the lazy mode on or off. In lazy mode the predictors
+	 * are not maintained by input() but rebuilt when calling
+	 * predict_next() or predict_all(), by replaying the last
+	 * w symbols on the current grammar. This is an approximation:
+	 * the context is limited to those w symbols, so the predictions
+	 * are usually a superset of the ones of the eager mode (the
+	 * same ones once a periodic sequence has been learned), not
+	 * necessarily the same.
+	 * \param[in] l : true to enable the lazy mode.
+	 * \param[in] w : number of symbols replayed on a rebuild.
+	 */
+	void set_lazy(bool l, size_t w = 32);
+
+	bool is_lazy() const {
+		return lazy;
+	}
+
+	/**
+	 * Bounds the depth of the grammar: a digram that appears twice
+	 * is left as is if replacing it by a rule would make any rule
+	 * (other than the start rule) deeper than d. This bounds the
+	 * cost of updating the predictors and of iterating over the
+	 * grammar, at the price of a longer start rule.
+	 * \param[in] d : maximum depth, 0 to remove the bound.
+	 */
+	void set_max_depth(int d);
+
+	int get_max_depth() const {
+		return max_depth;
+	}
+
+	/**
+	 * Switches the freeze mode on or off. Once a fraction t of the
+	 * last n inputs were predicted, the grammar is considered stable:
+	 * input() only moves the predictors forward, which is much cheaper
+	 * than learning. Learning resumes as soon as the hit rate of the
+	 * last n inputs falls below t, starting with the input that was
+	 * mispredicted. Ignored in lazy mode, where the predictors are not
+	 * kept up to date.
+	 * \param[in] n : number of inputs considered, 0 to disable.
+	 * \param[in] t : hit rate needed to freeze, between 0 and 1.
+	 */
+	void set_freeze(size_t n, double t);
+
+	bool is_frozen() const {
+		return frozen;
+	}
+
+	/**
+	 * Renames the terminals of the grammar: x becomes m[x] (terminals
+	 * beyond the end of m are left unchanged). m must not give the same
+	 * value to two terminals of the grammar.
+	 * \param[in] m : new value of each terminal.
+	 */
+	void remap(const std::vector<int>& m);
+
+	std::set<int> predict_next() {
+		if(stale) rebuild_predictors();
 		std::set<int> result;
 		std::set<symbols*>::iterator it = predictions.begin();
 		for(; it != predictions.end(); it++) {
@@ -114,8 +289,30 @@ class oracle {
 		return result;
 	}
 
+	/**
+	 * Calls f(x) once for each terminal x that predict_next() would
+	 * return, without allocating any memory (unless the predictors
+	 * have to be rebuilt in lazy mode).
+	 * \param[in] f : function or functor taking an int.
+	 * \return the number of terminals.
+	 */
+	template<typename F>
+	size_t for_each_prediction(F& f) {
+		if(stale) rebuild_predictors();
+		size_t n = 0;
+		std::set<symbols*>::const_iterator it = predictions.begin();
+		for(; it != predictions.end(); it++) {
+			if((*it)->nt() || predicted_before(it)) continue;
+			f((int)(*it)->value());
+			n++;
+		}
+		return n;
+	}
+
 	size_t size() const;
 
+	const statistics& get_statistics();
+
 	class iterator {
 		friend class oracle;
 		private:
@@ -152,7 +349,13 @@ class oracle {
 		return iterator(this);
 	}
 
-	std::list<iterator> predict_all() const;
+	std::list<iterator> predict_all();
+
+	// exports the grammar as a list of rules, the first one being
+	// the start rule. Terminals are encoded as 2*value+1 and
+	// non-terminals as 2*i, where i is the position of the
+	// referenced rule in the list.
+	void export_rules(std::vector<std::vector<ulong> >& out) const;
 
 	friend std::ostream& operator<<(std::ostream& stream, 
 					oracle& o);
@@ -45,15 +45,34 @@ rules::rules(oracle* o)
 	guard = new symbols(this, this);
 	guard->point_to_self();
 	count = number = 0;
+	depth_ = 1;
 	users.erase(guard);
 	oracle_->rules_set.insert(this);
+	oracle_->stats.rules_created++;
 }
 
 rules::~rules() { 
 	oracle_->rules_set.erase(this);
+	oracle_->stats.rules_destroyed++;
 	delete guard;
 }
 
+void rules::add_parent(rules* r)
+{
+	if(r == 0 || r == this) return; // detached symbol or guard
+	if(oracle_->max_depth == 0 || r == oracle_->start) return;
+	parents[r]++;
+}
+
+void rules::remove_parent(rules* r)
+{
+	if(r == 0 || r == this) return;
+	if(oracle_->max_depth == 0 || r == oracle_->start) return;
+	std::map<rules*,int>::iterator it = parents.find(r);
+	if(it == parents.end()) return;
+	if(--(it->second) == 0) parents.erase(it);
+}
+
 symbols *rules::first() const {
 	return guard->next(); 
 }
@@ -37,6 +37,7 @@
 
 #include <cstdlib> 
 #include <set>
+#include <map>
 
 namespace omniscio {
 namespace sequitur {
@@ -59,6 +60,14 @@ class rules {
 	int count;
 
 	std::set<symbols*> users; // keeps track of instanciations of the rule
+
+	// upper bound on the number of rules to go through (including
+	// this one) to reach a terminal, and rules other than the start
+	// rule in which this rule is used (with the number of uses).
+	// Both are only maintained when the oracle bounds the depth of
+	// its grammar.
+	int depth_;
+	std::map<rules*,int> parents;
 	// this is just for numbering the rules nicely for printing; it's
 	// not essential for the algorithm
 
@@ -90,6 +99,16 @@ class rules {
 	int index() const { return number; };
 	void index(int i) { number = i; };
 
+	int depth() const { return depth_; }
+	void depth(int d) { depth_ = d; }
+
+	void add_parent(rules* r);
+	void remove_parent(rules* r);
+
+	std::map<rules*,int>& get_parents() {
+		return parents;
+	}
+
 	oracle* get_oracle() const { return oracle_; }
 
 	std::set<symbols*>& get_users() {
@@ -82,6 +82,8 @@ void symbols::expand() {
 	symbols *f = rule()->first();
 	symbols *l = rule()->last();
 
+	owner->get_oracle()->stats.expansions++;
+
 	// if this symbol is a predictor, copy its nested predictor symbols
 	// into the users that have this symbol as a predictor (usr = only A)
 	if(is_pred()) {
@@ -98,10 +100,10 @@ void symbols::expand() {
 	// before deleting the rule, change the owner of all sub-symbols
 	symbols *ns = rule()->first();
 	while(ns != rule()->last()) {
-		ns->owner = owner;
+		ns->set_owner(owner);
 		ns = ns->next();
 	}
-	ns->owner = owner;
+	ns->set_owner(owner);
 
 	delete_digram();
 	delete rule();
@@ -123,8 +125,12 @@ void symbols::substitute(rules *r)
 {
 	symbols *q = p; // q = previous
 
+	owner->get_oracle()->stats.substitutions++;
+
 	// create the new symbol ("B" in rule A in the example)
 	symbols* B  = new symbols(r,owner);
+	if(owner->get_oracle()->max_depth != 0)
+		owner->get_oracle()->raise_depth(owner,r->depth()+1);
 	symbols* X1 = this;
 	symbols* X2 = r->first();
 	symbols* Y1 = X1->next();
@@ -184,6 +190,7 @@ void symbols::substitute(rules *r)
 void symbols::match(symbols *ss, symbols *m) 
 {
 	rules *r;
+	ss->owner->get_oracle()->stats.matches++;
 	// reuse an existing rule
 
 	if (m->prev()->is_guard() 
@@ -213,6 +220,9 @@ void symbols::match(symbols *ss, symbols *m)
 			r->last()->insert_after(
 				new symbols(ss->next()->value(),r));
 
+		if (r->get_oracle()->max_depth != 0)
+			r->get_oracle()->compute_depth(r);
+
 		m->substitute(r);
 		ss->substitute(r);
 
@@ -221,8 +231,16 @@ void symbols::match(symbols *ss, symbols *m)
 
 	// check for an underused rule
 
-	if (r->first()->nt() && r->first()->rule()->freq() == 1) 
+	if (r->first()->nt() && r->first()->rule()->freq() == 1) {
 		r->first()->expand();
+		if (r->get_oracle()->max_depth != 0)
+			r->get_oracle()->compute_depth(r);
+	}
+}
+
+bool symbols::can_match(symbols* m)
+{
+	return owner->get_oracle()->can_match(this,m);
 }
 
 // When called on a rule, the first item of the rule
@@ -341,7 +359,7 @@ int symbols::compute_next_predictors(symbols* matching) {
 	}
 }
 
-void symbols::update_predictors() {
+void symbols::update_predictors(std::vector<symbols*>& promoted) {
 	if(not is_pred()) return;
 	if(not next_updated) return;
 
@@ -349,14 +367,11 @@ void symbols::update_predictors() {
 	std::set<symbols*>::iterator it = predictors.begin();
 
 	for(; it != predictors.end(); it++) {
-		(*it)->update_predictors();
+		(*it)->update_predictors(promoted);
 	}
 
-	it = next_new_predictor.begin();
-
-	for(; it != next_new_predictor.end(); it++) {
-		(*it)->become_predictor_down_left();
-	}
+	promoted.insert(promoted.end(),
+		next_new_predictor.begin(),next_new_predictor.end());
 	
 	is_predictor = next_is_predictor;
 	if(is_predictor) {
@@ -395,7 +410,10 @@ symbols::~symbols() {
 	join(p, n);
 	if (!is_guard()) {
 		delete_digram();
-		if (nt()) rule()->deuse(this);
+		if (nt()) {
+			rule()->remove_parent(owner);
+			rule()->deuse(this);
+		}
 	}
 	if(is_pred() && (not nt()) && (owner != (rules*)0)) {
 		owner->get_oracle()->remove_prediction(this);
@@ -36,6 +36,7 @@
 #define SEQUITUR_SYMBOLS_H
 
 #include <iostream>
+#include <vector>
 #include "rules.hpp"
 
 namespace omniscio {
@@ -75,6 +76,7 @@ class symbols {
 		p = n = 0;
 		rule()->reuse(this);
 		owner = o;
+		rule()->add_parent(o);
 		is_predictor = false;
 		next_updated = false;
 	}
@@ -111,7 +113,7 @@ class symbols {
 		}
 
 		// update the new owner of the right symbol 
-		right->owner = left->owner;
+		right->set_owner(left->owner);
 		left->n = right; right->p = left;
 	}
 
@@ -139,12 +141,31 @@ class symbols {
 	inline ulong raw_value() {  return s; };
 	inline ulong value() { return s / 2;};
 
+	// assuming this is a terminal, changes its value
+	inline void set_value(ulong sym) { s = sym * 2 + 1; };
+
 	// assuming this is a non-terminal, returns the corresponding rule
 	rules *rule() { return (rules *) s;};
 
 	void substitute(rules *r);
 	static void match(symbols *s, symbols *m);
 
+	// false if matching this digram with the one starting at m
+	// would make the grammar deeper than allowed by the oracle.
+	bool can_match(symbols* m);
+
+	rules* get_owner() const { return owner; }
+
+	// changes the rule in which this symbol appears, keeping
+	// track of the rules using a non-terminal.
+	void set_owner(rules* o) {
+		if(nt() && o != owner) {
+			if(owner != (rules*)0) rule()->remove_parent(owner);
+			rule()->add_parent(o);
+		}
+		owner = o;
+	}
+
 	// checks a new digram. If it appears elsewhere, 
 	// deals with it by calling match(), otherwise inserts 
 	// it into the hash table
@@ -156,6 +177,7 @@ class symbols {
 			return 0;
 		}
 		if(x->next() != this) {
+			if(not can_match(x)) return 0;
 			match(this,x);
 		}
 		return 1;
@@ -205,8 +227,21 @@ class symbols {
 	// to be updated, but it should also stay a predictor itself.
 	int compute_next_predictors(symbols* matching);
 
-	// makes the next_* value the current ones.
-	void update_predictors();
+	// makes the next_* value the current ones. The symbols that
+	// become predictors are appended to promoted, the caller must
+	// call become_predictor_down_left on them once the whole
+	// hierarchy is updated (otherwise a symbol promoted by one
+	// parent could be reset when updated through another one).
+	void update_predictors(std::vector<symbols*>& promoted);
+
+	// forgets all predictor state attached to this symbol.
+	void reset_predictor() {
+		is_predictor = false;
+		next_updated = false;
+		predictors.clear();
+		next_new_predictor.clear();
+		next_stay_predictor.clear();
+	}
 
 	// search for predictors in the rull in which this symbol appears,
 	// given the last symbol read (this symol bught be a non-terminal).
@@ -125,26 +125,36 @@ class size_tracker {
 			return occurences;
 		}
 
+		// sums the sizes of the predicted symbols, weighted by
+		// their occurences
+		struct weighted_sum {
+			const gram_size* gs;
+			size_t size;	// size of the last symbol
+			double sum;
+			long n;
+			weighted_sum(const gram_size* g)
+			: gs(g), size(0), sum(0.0), n(0) {}
+			void operator()(int sym) {
+				std::map<int,size_t>::const_iterator s
+					= gs->symbols_size.find(sym);
+				if(s == gs->symbols_size.end()) return;
+				long occ = gs->occ_map.find(s->second)->second;
+				size = s->second;
+				n += occ;
+				sum += (double)size*occ;
+			}
+		};
+
 		virtual size_t predict() {
-			std::set<int> pred = o.predict_next();
-			if(pred.size() == 0) {
+			weighted_sum w(this);
+			size_t k = o.for_each_prediction(w);
+			if(k == 0 || w.n == 0) {
 				return average_size;
 			}
-			std::set<int>::iterator it = pred.begin();
-			if(pred.size() == 1) {
-				int sym = *pred.begin();
-				return symbols_size[sym];
-			}
-			double avg = 0.0;
-			int n = 0;
-			for(; it != pred.end(); it++) {
-				int sym = *it;
-				size_t p = symbols_size[sym];
-				n += occ_map[p];
-				avg += (double)p*occ_map[p];
+			if(k == 1) {
+				return w.size;
 			}
-			avg /= n;
-			return (size_t)avg;
+			return (size_t)(w.sum/w.n);
                 }
 
 		virtual void input(size_t s) {
@@ -295,7 +305,7 @@ class size_tracker {
 		}
 	}
 
-	size_t predict() {
+	size_t predict() const {
 		if(st) return st->predict();
 		else return 0;
 	}
@@ -0,0 +1,152 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef OMNISCIO_HISTOGRAM_H
+#define OMNISCIO_HISTOGRAM_H
+
+#include <cstring>
+
+namespace omniscio {
+
+#define HISTOGRAM_SUB_BITS	3
+#define HISTOGRAM_SUB		(1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BINS		(HISTOGRAM_SUB*(64-HISTOGRAM_SUB_BITS+1))
+
+/**
+ * The histogram class counts durations (or any non-negative integer)
+ * in log-bucketed bins: each power of 2 is split into HISTOGRAM_SUB
+ * bins, so that a percentile is read with a relative error below
+ * 1/HISTOGRAM_SUB whatever the magnitude. Adding a value is a few
+ * instructions and never allocates. A histogram is not protected
+ * against concurrent updates.
+ */
+class histogram {
+
+	private:
+
+	long		bins[HISTOGRAM_BINS];
+	long		count;
+	long long	total;
+	long long	max;
+
+	/**
+	 * Returns the bin of a value. Values below HISTOGRAM_SUB have
+	 * their own bin.
+	 */
+	static int bin_of(unsigned long long x) {
+		if(x < HISTOGRAM_SUB) return (int)x;
+		int e = 63 - __builtin_clzll(x);
+		int sub = (int)(x >> (e - HISTOGRAM_SUB_BITS)) 
+			& (HISTOGRAM_SUB-1);
+		return HISTOGRAM_SUB*(e - HISTOGRAM_SUB_BITS + 1) + sub;
+	}
+
+	/**
+	 * Returns the smallest value of a bin.
+	 */
+	static unsigned long long lower_bound(int b) {
+		if(b < HISTOGRAM_SUB) return b;
+		int e = b/HISTOGRAM_SUB + HISTOGRAM_SUB_BITS - 1;
+		unsigned long long sub = b % HISTOGRAM_SUB;
+		return (HISTOGRAM_SUB + sub) << (e - HISTOGRAM_SUB_BITS);
+	}
+
+	public:
+
+	histogram() {
+		clear();
+	}
+
+	void clear() {
+		std::memset(bins,0,sizeof(bins));
+		count = 0;
+		total = 0;
+		max = 0;
+	}
+
+	/**
+	 * Counts a value, negative values are counted as 0.
+	 */
+	void add(long long x) {
+		if(x < 0) x = 0;
+		bins[bin_of(x)] += 1;
+		count += 1;
+		total += x;
+		if(x > max) max = x;
+	}
+
+	/**
+	 * Adds the values counted by another histogram.
+	 */
+	histogram& operator+=(const histogram& h) {
+		for(int b = 0; b < HISTOGRAM_BINS; b++) bins[b] += h.bins[b];
+		count += h.count;
+		total += h.total;
+		if(h.max > max) max = h.max;
+		return *this;
+	}
+
+	long get_count() const {
+		return count;
+	}
+
+	long long get_total() const {
+		return total;
+	}
+
+	long long get_max() const {
+		return max;
+	}
+
+	/**
+	 * Returns the value below which the given percentage of the
+	 * counted values are, up to the width of a bin (the middle of the
+	 * bin is returned, never more than the largest value counted).
+	 * \param[in] percent : between 0 and 100.
+	 * \return the percentile, 0 if no value was counted.
+	 */
+	long long percentile(double percent) const {
+		if(count == 0) return 0;
+		if(percent >= 100.0) return max;
+		double rank = count*(percent < 0.0 ? 0.0 : percent)/100.0;
+		long seen = 0;
+		int b = 0;
+		for(; b < HISTOGRAM_BINS-1; b++) {
+			seen += bins[b];
+			if(seen > rank) break;
+		}
+		unsigned long long lo = lower_bound(b);
+		unsigned long long hi = b+1 < HISTOGRAM_BINS ? 
+			lower_bound(b+1) : lo;
+		long long mid = (long long)(lo + (hi-lo)/2);
+		return mid < max ? mid : max;
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,236 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+/**
+ * omniscio-symbolize resolves offline the frames stored in a dictionary
+ * file (<prefix>dict), using the table of modules recorded by the same
+ * process (<prefix>modules) and addr2line. Each frame is a module key
+ * and an offset in the module (see modules.hpp). The symbolized
+ * dictionary is written on the standard output, one entry per line.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <unistd.h>
+
+struct module {
+	std::string		build_id;
+	std::string		path;
+	std::set<uint32_t>	offsets;
+};
+
+static std::map<uint32_t,module>		_modules_;
+static std::map<uint64_t,std::string>		_symbols_;
+
+/**
+ * Reads the table of modules, one "key build-id path" line per module.
+ */
+static bool read_modules(const std::string& filename)
+{
+	std::ifstream in(filename.c_str());
+	if(not in.good()) return false;
+	std::string line;
+	while(std::getline(in,line)) {
+		std::stringstream ss(line);
+		std::string key;
+		module m;
+		if(not (ss >> key >> m.build_id)) continue;
+		std::getline(ss,m.path);
+		size_t p = m.path.find_first_not_of(' ');
+		m.path = (p == std::string::npos) ? "" : m.path.substr(p);
+		if(m.build_id == "-") m.build_id.clear();
+		_modules_[std::strtoul(key.c_str(),NULL,16)] = m;
+	}
+	return true;
+}
+
+/**
+ * File to give to addr2line: the separate debug information if it is
+ * installed, the module itself otherwise.
+ */
+static std::string debug_file(const module& m)
+{
+	if(m.build_id.size() > 2) {
+		std::string d = "/usr/lib/debug/.build-id/"
+			+ m.build_id.substr(0,2) + "/"
+			+ m.build_id.substr(2) + ".debug";
+		if(access(d.c_str(),R_OK) == 0) return d;
+	}
+	return m.path;
+}
+
+static std::vector<uint64_t> parse_frames(const std::string& s)
+{
+	std::vector<uint64_t> frames;
+	std::stringstream ss(s);
+	std::string item;
+	while(std::getline(ss,item,';')) {
+		frames.push_back(std::strtoull(item.c_str(),NULL,16));
+	}
+	return frames;
+}
+
+static std::string quote(const std::string& s)
+{
+	std::string r("'");
+	for(size_t i = 0; i < s.size(); i++) {
+		if(s[i] == '\'') r += "'\\''";
+		else r += s[i];
+	}
+	return r + "'";
+}
+
+/**
+ * Runs addr2line on the offsets of a module, by batches.
+ */
+static void symbolize(uint32_t key, const module& mod)
+{
+	std::string file = debug_file(mod);
+	std::set<uint32_t>::const_iterator it = mod.offsets.begin();
+	while(it != mod.offsets.end()) {
+		std::vector<uint32_t> batch;
+		std::stringstream cmd;
+		cmd << "addr2line -C -f -e " << quote(file) << std::hex;
+		for(; it != mod.offsets.end() && batch.size() < 256; it++) {
+			// a return address, the call is just before
+			cmd << " 0x" << (*it - 1);
+			batch.push_back(*it);
+		}
+
+		FILE* p = popen(cmd.str().c_str(),"r");
+		if(p == NULL) return;
+		char function[4096], location[4096];
+		for(size_t i = 0; i < batch.size(); i++) {
+			if(fgets(function,sizeof(function),p) == NULL
+			|| fgets(location,sizeof(location),p) == NULL) break;
+			function[strcspn(function,"\n")] = '\0';
+			location[strcspn(location,"\n")] = '\0';
+			std::stringstream ss;
+			ss << function << " (" << location << ")";
+			_symbols_[((uint64_t)key << 32) | batch[i]] = ss.str();
+		}
+		pclose(p);
+	}
+}
+
+static void print_frame(std::ostream& os, uint64_t frame)
+{
+	uint32_t key = frame >> 32;
+	uint32_t offset = frame & 0xffffffff;
+	std::map<uint32_t,module>::const_iterator m = _modules_.find(key);
+	if(key == 0 || m == _modules_.end()) {
+		os << "?? [0x" << std::hex << frame << std::dec << "]";
+		return;
+	}
+	std::map<uint64_t,std::string>::const_iterator s
+		= _symbols_.find(frame);
+	if(s != _symbols_.end()) os << s->second << " ";
+	os << "[" << m->second.path << "+0x" << std::hex 
+	   << offset << std::dec << "]";
+}
+
+static void usage(const char* name)
+{
+	std::cerr << "Usage: " << name << " dictionary [modules]" 
+		  << std::endl;
+	std::cerr << "  modules defaults to the dictionary file name "
+		  << "with its \"dict\" suffix replaced by \"modules\"." 
+		  << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 2 || argc > 3) {
+		usage(argv[0]);
+		exit(0);
+	}
+
+	std::string dict(argv[1]);
+	std::string modules;
+	if(argc == 3) {
+		modules = argv[2];
+	} else if(dict.size() >= 4 && dict.substr(dict.size()-4) == "dict") {
+		modules = dict.substr(0,dict.size()-4) + "modules";
+	} else {
+		usage(argv[0]);
+		exit(-1);
+	}
+
+	if(not read_modules(modules)) {
+		std::cerr << "Unable to read " << modules << std::endl;
+		exit(-1);
+	}
+
+	std::ifstream in(dict.c_str());
+	if(not in.good()) {
+		std::cerr << "Unable to read " << dict << std::endl;
+		exit(-1);
+	}
+
+	// first pass: gather the offsets of each module
+	std::vector<std::pair<std::string,std::vector<uint64_t> > > entries;
+	std::string line;
+	while(std::getline(in,line)) {
+		size_t c = line.find(':');
+		if(c == std::string::npos) continue;
+		std::vector<uint64_t> frames = parse_frames(line.substr(c+1));
+		for(size_t i = 0; i < frames.size(); i++) {
+			std::map<uint32_t,module>::iterator m 
+				= _modules_.find(frames[i] >> 32);
+			if(m != _modules_.end())
+				m->second.offsets.insert(frames[i] & 0xffffffff);
+		}
+		entries.push_back(std::make_pair(line.substr(0,c+1),frames));
+	}
+
+	std::map<uint32_t,module>::iterator it;
+	for(it = _modules_.begin(); it != _modules_.end(); it++) {
+		if(it->second.offsets.empty()) continue;
+		symbolize(it->first,it->second);
+	}
+
+	// second pass: print the symbolized entries
+	for(size_t i = 0; i < entries.size(); i++) {
+		std::cout << entries[i].first;
+		const std::vector<uint64_t>& frames = entries[i].second;
+		for(size_t j = 0; j < frames.size(); j++) {
+			print_frame(std::cout,frames[j]);
+			if(j != frames.size()-1) std::cout << ";";
+		}
+		std::cout << std::endl;
+	}
+	return 0;
+}
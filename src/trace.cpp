@@ -25,70 +25,65 @@
  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 *******************************************************************************/
 
-#include <cstdlib>
 #include <cstring>
-#include <string>
+#include <link.h>
+#include <stdint.h>
 #include "trace.hpp"
-#ifdef HAVE_CXXABI
-#include <cxxabi.h>
-#endif
-#undef HAVE_CXXABI
 namespace omniscio {
 
-std::ostream& operator<<(std::ostream& os, const trace& t)
-{
-	size_t s = t.size();
-	char** strings = backtrace_symbols(&(t[0]),s);
-	for(size_t i = 0; i < s; i++) {
+#define MAX_SKIPPED_SEGMENTS 16
 
-		char* a = std::strstr(strings[i],"(");
-		char* a2 = std::strstr(strings[i],")");
-		char* b = NULL;
-		char* c = NULL;
+// executable segments of the modules skipped in traces
+static uintptr_t _skipped_start_[MAX_SKIPPED_SEGMENTS];
+static uintptr_t _skipped_end_[MAX_SKIPPED_SEGMENTS];
+static int _num_skipped_ = 0;
 
-		std::string filename;
-		std::string function;
+static int find_segments(struct dl_phdr_info* info, size_t, void* data)
+{
+	const char* name = (const char*)data;
+	if(info->dlpi_name == NULL || std::strstr(info->dlpi_name,name) == NULL)
+		return 0;
+	for(int i = 0; i < info->dlpi_phnum; i++) {
+		const ElfW(Phdr)& ph = info->dlpi_phdr[i];
+		if(ph.p_type != PT_LOAD || (ph.p_flags & PF_X) == 0) continue;
+		if(_num_skipped_ == MAX_SKIPPED_SEGMENTS) return 1;
+		_skipped_start_[_num_skipped_] = info->dlpi_addr + ph.p_vaddr;
+		_skipped_end_[_num_skipped_] = info->dlpi_addr + ph.p_vaddr
+						+ ph.p_memsz;
+		_num_skipped_ += 1;
+	}
+	return 0;
+}
 
-		if(a == NULL) {
-			os << strings[i];
-			continue;
-		}
+int trace::skip_module(const char* name)
+{
+	int n = _num_skipped_;
+	dl_iterate_phdr(find_segments,(void*)name);
+	return _num_skipped_ - n;
+}
 
-		if(a+1 != a2 && a2 != NULL) {
-			filename = std::string(strings[i],
-					(size_t)(a - strings[i]));
-			a += 1;
-			b = std::strstr(a,"+");
-			if(b != NULL) {
-				function = std::string(a,(size_t)(b - a));
-			}
-			b += 1;
-		}
-		c = std::strstr(strings[i],")");
-		std::string offset;
-		if(b != NULL) {
-			offset = std::string(b,(size_t)(c-b));
+size_t trace::filter_frames(omniscio_addr* frames, size_t n)
+{
+	if(_num_skipped_ == 0) return n;
+	size_t j = 0;
+	for(size_t i = 0; i < n; i++) {
+		uintptr_t a = (uintptr_t)frames[i];
+		bool skip = false;
+		for(int k = 0; k < _num_skipped_ && not skip; k++) {
+			skip = (a > _skipped_start_[k] && a <= _skipped_end_[k]);
 		}
-		std::string address(c+1);
+		if(not skip) frames[j++] = frames[i];
+	}
+	return j;
+}
 
-#ifdef HAVE_CXXABI
-		int status;
-		char* res = abi::__cxa_demangle(function.c_str(),0,0,&status);
-		if(status == 0) {
-			os << filename << " (" << res << "+" 
-			<< offset << ") " << address;
-			free(res);
-		} else {
-			os << filename << " (" << function << "+"
-			<< offset << ") " << address;
-		}
-#else
-		os << filename << " (" << function << "+" 
-			<< offset << ") " << address;
-#endif
+std::ostream& operator<<(std::ostream& os, const trace& t)
+{
+	size_t s = t.size();
+	for(size_t i = 0; i < s; i++) {
+		os << t[i];
 		if(i != s-1) os << ";";
 	}
-	free(strings);
 	return os;
 }
 
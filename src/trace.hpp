@@ -29,26 +29,114 @@
 #define OMNISCIO_TRACE_H
 
 #include <iostream>
-#include <vector>
-#include <execinfo.h>
+#include <string>
 #include "omniscio.h"
+#include "unwind.hpp"
+#include "modules.hpp"
 
 namespace omniscio {
 
 typedef void* omniscio_addr;
 
-class trace : public std::vector<omniscio_addr> {
+#define OMNISCIO_MAX_FRAMES 256
+
+/**
+ * A call stack, captured in a fixed-size buffer that lives wherever
+ * the trace lives (usually the stack of the traced call), so that no
+ * memory is allocated while tracing. The frames are accessed through
+ * pointer iterators, as expected by dictionary::insert(start,end).
+ */
+class trace {
+
+	omniscio_addr	frames[OMNISCIO_MAX_FRAMES];
+	size_t		captured;	// number of frames captured
+	size_t		length;		// number of frames exposed
 
 	public:
 
-	trace(size_t size) : std::vector<omniscio_addr>(size) {
-		size_t s = backtrace(&((*this)[0]),size);
-		resize(s);
+	typedef omniscio_addr		value_type;
+	typedef omniscio_addr*		iterator;
+	typedef const omniscio_addr*	const_iterator;
+
+	trace() : captured(0), length(0) {}
+
+	/**
+	 * Captures the current call stack.
+	 * Always inlined, so that the first frame is the caller's.
+	 * \param[in] size : maximum number of frames (at most
+	 * OMNISCIO_MAX_FRAMES).
+	 */
+	inline __attribute__((always_inline))
+	trace(size_t size) {
+		if(size > OMNISCIO_MAX_FRAMES) size = OMNISCIO_MAX_FRAMES;
+		captured = unwind(frames,size);
+		captured = filter_frames(frames,captured);
+		length = captured;
+	}
+
+	size_t size() const { return length; }
+	bool empty() const { return length == 0; }
+	static size_t capacity() { return OMNISCIO_MAX_FRAMES; }
+
+	iterator begin() { return frames; }
+	iterator end() { return frames+length; }
+	const_iterator begin() const { return frames; }
+	const_iterator end() const { return frames+length; }
+
+	omniscio_addr& operator[](size_t i) { return frames[i]; }
+	const omniscio_addr& operator[](size_t i) const { return frames[i]; }
+
+	/**
+	 * Exposes only the n innermost frames (or all the captured frames
+	 * if there are less than n). Hidden frames can be exposed again.
+	 */
+	void resize(size_t n) {
+		length = (n < captured) ? n : captured;
+	}
+
+	/**
+	 * Replaces the return addresses by their (module, offset) form,
+	 * which does not depend on where the modules are loaded
+	 * (see modules.hpp).
+	 */
+	void normalize() {
+		normalize_frames(frames,captured);
+	}
+
+	/**
+	 * Drops the n innermost frames.
+	 */
+	void skip(size_t n) {
+		if(n > captured) n = captured;
+		for(size_t i = n; i < captured; i++) frames[i-n] = frames[i];
+		captured -= n;
+		length = (n < length) ? length - n : 0;
 	}
 
 	friend std::ostream& operator<<(std::ostream& os, const trace& t);
+
+	/**
+	 * Removes from a list of frames the ones that belong to a module
+	 * registered with skip_module.
+	 * \param[in,out] frames : return addresses.
+	 * \param[in] n : number of return addresses.
+	 * \return the number of remaining frames.
+	 */
+	static size_t filter_frames(omniscio_addr* frames, size_t n);
+
+	/**
+	 * Registers the executable segments of the loaded modules whose
+	 * path contains name, so that their frames do not appear in traces.
+	 * \param[in] name : part of the path of the module.
+	 * \return the number of segments registered.
+	 */
+	static int skip_module(const char* name);
 };
 
+/**
+ * Writes the frames of a trace in hexadecimal, separated by ';'.
+ * No symbolization is done at runtime (see omniscio-symbolize).
+ */
 std::ostream& operator<<(std::ostream& os, const trace& t);
 
 }
@@ -28,19 +28,76 @@
 #ifndef OMNISCIO_TREE_H
 #define OMNISCIO_TREE_H
 
+#include <algorithm>
 #include <iterator>
+#include <vector>
+#include <new>
+#include <stdint.h>
 
 namespace omniscio {
 
+/**
+ * Default key of a tree element: the element itself.
+ */
 template<typename T>
+struct tree_identity {
+	typedef T key_type;
+	const T& operator()(const T& t) const { return t; }
+};
+
+/**
+ * Hash of a key, used by the child index of wide nodes. The default
+ * version hashes the bytes of the key (FNV-1a).
+ */
+template<typename K>
+struct tree_hash {
+	uint64_t operator()(const K& k) const {
+		const unsigned char* b = (const unsigned char*)&k;
+		uint64_t h = 14695981039346656037ULL;
+		for(size_t i = 0; i < sizeof(K); i++) {
+			h ^= b[i];
+			h *= 1099511628211ULL;
+		}
+		return h ^ (h >> 29);
+	}
+};
+
+/**
+ * A tree whose nodes keep their children in insertion order.
+ *
+ * Nodes are allocated by blocks from a pool owned by the tree and
+ * are only released with the tree. Children are found with
+ * find_child by the key that KeyOf extracts from an element (it must
+ * provide key_type and operator(), keys must have == and < and be
+ * hashable by tree_hash): the siblings are scanned while they are
+ * few, then a sorted index of the children is searched, which becomes
+ * a hash table once the node gets wider.
+ */
+template<typename T, typename KeyOf = tree_identity<T> >
 class tree {
 
 public:
 
 	class iterator;
 
+	typedef typename KeyOf::key_type key_type;
+
 private:
 
+	// up to SCAN_LIMIT children, the siblings are scanned, up to
+	// SORTED_LIMIT they are indexed in a sorted vector, then hashed
+	enum { SCAN_LIMIT = 8, SORTED_LIMIT = 64, BLOCK_SIZE = 256 };
+
+	class node;
+
+	struct child_index {
+		std::vector<node*> children; // sorted or hash table
+		size_t count;
+		bool hashed;
+
+		child_index() : count(0), hashed(false) {}
+	};
+
 	class node {
 
 		friend class iterator;
@@ -53,12 +110,18 @@ private:
 		node* last_child;
 		node* prev_sibling;
 		node* next_sibling;
+		size_t num_children;
+		child_index* index;
 		
 	public:
 
-		node(const T& t) : val(t), parent(0) {}
+		node(const T& t) : val(t), parent(0), first_child(0),
+			last_child(0), prev_sibling(0), next_sibling(0),
+			num_children(0), index(0) {}
 
-		node(const T& t, node* p) : val(t), parent(p) {}
+		node(const T& t, node* p) : val(t), parent(p), first_child(0),
+			last_child(0), prev_sibling(0), next_sibling(0),
+			num_children(0), index(0) {}
 
 		const T& value() const {
 			return val;
@@ -68,17 +131,122 @@ private:
 			return val;
 		}
 
+		// children are released by the pool of the tree
 		~node() {
-			node* n = first_child;
-			while(n != NULL) {
-				node* m = n->next_sibling;
-				delete n;
-				n = m;
-			}
+			delete index;
 		}
 		
 	};
 
+	static key_type key(const node* n) {
+		return KeyOf()(n->val);
+	}
+
+	struct key_less {
+		bool operator()(const node* a, const key_type& k) const {
+			return key(a) < k;
+		}
+	};
+
+	static void hash_insert(std::vector<node*>& table, node* c) {
+		size_t mask = table.size() - 1;
+		size_t i = tree_hash<key_type>()(key(c)) & mask;
+		while(table[i] != NULL) i = (i+1) & mask;
+		table[i] = c;
+	}
+
+	static void index_child(node* n, node* c) {
+		if(n->num_children <= SCAN_LIMIT) return;
+		if(n->index == NULL) {
+			// first time: index all the children
+			n->index = new child_index();
+			for(node* m = n->first_child; m != c; m = m->next_sibling)
+				index_child(n,m);
+		}
+		child_index& x = *(n->index);
+		x.count += 1;
+		if(not x.hashed && x.count > SORTED_LIMIT) {
+			std::vector<node*> table(4*SORTED_LIMIT,(node*)NULL);
+			for(size_t i = 0; i < x.children.size(); i++)
+				hash_insert(table,x.children[i]);
+			x.children.swap(table);
+			x.hashed = true;
+		}
+		if(x.hashed) {
+			if(2*x.count > x.children.size()) {
+				std::vector<node*> table(2*x.children.size(),
+							(node*)NULL);
+				for(size_t i = 0; i < x.children.size(); i++)
+					if(x.children[i] != NULL)
+						hash_insert(table,x.children[i]);
+				x.children.swap(table);
+			}
+			hash_insert(x.children,c);
+		} else {
+			typename std::vector<node*>::iterator it =
+				std::lower_bound(x.children.begin(),
+					x.children.end(),key(c),key_less());
+			x.children.insert(it,c);
+		}
+	}
+
+	static node* find(const node* n, const key_type& k) {
+		if(n->index == NULL) {
+			for(node* c = n->first_child; c != NULL; c = c->next_sibling)
+				if(key(c) == k) return c;
+			return NULL;
+		}
+		const std::vector<node*>& v = n->index->children;
+		if(n->index->hashed) {
+			size_t mask = v.size() - 1;
+			for(size_t i = tree_hash<key_type>()(k) & mask; 
+			    v[i] != NULL; i = (i+1) & mask) {
+				if(key(v[i]) == k) return v[i];
+			}
+			return NULL;
+		}
+		typename std::vector<node*>::const_iterator it =
+			std::lower_bound(v.begin(),v.end(),k,key_less());
+		if(it != v.end() && key(*it) == k) return *it;
+		return NULL;
+	}
+
+	/**
+	 * Pool from which the nodes are allocated, by blocks
+	 * of BLOCK_SIZE nodes. Nodes are destroyed with the pool.
+	 */
+	class pool {
+
+		std::vector<node*> blocks;
+		size_t used; // in the last block
+
+		pool(const pool&);
+		pool& operator=(const pool&);
+
+	public:
+
+		pool() : used(BLOCK_SIZE) {}
+
+		node* create(const T& t, node* parent) {
+			if(used == BLOCK_SIZE) {
+				blocks.push_back((node*)::operator new(
+					BLOCK_SIZE*sizeof(node)));
+				used = 0;
+			}
+			node* n = new(blocks.back()+used) node(t,parent);
+			used += 1;
+			return n;
+		}
+
+		~pool() {
+			for(size_t i = 0; i < blocks.size(); i++) {
+				size_t s = (i+1 == blocks.size()) ? used : (size_t)BLOCK_SIZE;
+				for(size_t j = 0; j < s; j++) blocks[i][j].~node();
+				::operator delete(blocks[i]);
+			}
+		}
+	};
+
 public:
 
 	class iterator {
@@ -88,8 +256,9 @@ public:
 	private:
 		
 		node* n;
+		pool* p;
 
-		iterator(node *n_) : n(n_) {}
+		iterator(node *n_, pool* p_) : n(n_), p(p_) {}
 
 	public:
 
@@ -99,9 +268,9 @@ public:
 		typedef T* pointer;
 		typedef T& reference;
 
-		iterator() : n(NULL) {}
+		iterator() : n(NULL), p(NULL) {}
 
-		iterator(const iterator& it) : n(it.n) {}
+		iterator(const iterator& it) : n(it.n), p(it.p) {}
 
 		iterator& operator++() {
 			n = n->next_sibling;
@@ -139,16 +308,24 @@ public:
 		}
 
 		iterator begin() const {
-			return iterator(n->first_child);
+			return iterator(n->first_child,p);
 		}
 
 		iterator end() const {
-			return iterator(NULL);
+			return iterator(NULL,p);
+		}
+
+		/**
+		 * Finds the child whose key is the key of t.
+		 * \param[in] t : element to look for.
+		 * \return the child, end() if there is none.
+		 */
+		iterator find_child(const T& t) const {
+			return iterator(find(n,KeyOf()(t)),p);
 		}
 
 		iterator append_child(const T& t) const {
-			node* c = new node(t,n);
-			c->parent = n;
+			node* c = p->create(t,n);
 			if(n->last_child == NULL) {
 				n->last_child = c;
 				n->first_child = c;
@@ -158,56 +335,51 @@ public:
 				c->prev_sibling = old_last_child;
 				n->last_child = c;
 			}
-			return iterator(c);
+			n->num_children += 1;
+			index_child(n,c);
+			return iterator(c,p);
 		}
 
 	};
 
 private:
 
+	pool nodes;
 	node* first_root;
 	node* last_root;
 
+	tree(const tree&);
+	tree& operator=(const tree&);
+
 public:
 
 	tree() : first_root(NULL), last_root(NULL) {}
 
 	iterator add_root(const T& t) {
-		node* n = NULL;
+		node* n = nodes.create(t,NULL);
 		if(first_root == NULL) {
-			first_root = new node(t,NULL);
-			last_root = first_root;
-			n = first_root;
+			first_root = n;
+			last_root = n;
 		} else {
-			n = new node(t,NULL);
 			n->prev_sibling = last_root;
 			last_root->next_sibling = n;
 			last_root = n;
 		}
-		return iterator(n);
+		return iterator(n,&nodes);
 	}
 
 	iterator begin() {
-		return iterator(first_root);
+		return iterator(first_root,&nodes);
 	}
 
 	iterator end() {
-		return iterator(NULL);
+		return iterator(NULL,&nodes);
 	}
 
 	bool is_empty() const {
 		return first_root == NULL;
 	}
 
-	~tree() {
-		node* n = first_root;
-		while(n != NULL) {
-			node* m = n->next_sibling;
-			delete n;
-			n = m;
-		}
-	}
-
 };
 
 }
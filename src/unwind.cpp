@@ -0,0 +1,121 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <cstring>
+#include <alloca.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <execinfo.h>
+#ifdef HAVE_LIBUNWIND
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#endif
+#include "unwind.hpp"
+
+namespace omniscio {
+
+unwinder unwind = unwind_glibc;
+
+size_t __attribute__((noinline)) unwind_glibc(void** buffer, size_t size)
+{
+	// the first address is in this function, the other unwinders
+	// start with the caller: one more frame fills the buffer as well
+	void** frames = (void**)alloca((size+1)*sizeof(void*));
+	int s = backtrace(frames,size+1);
+	if(s <= 1) return 0;
+	std::memcpy(buffer,frames+1,(s-1)*sizeof(void*));
+	return s-1;
+}
+
+// upper limit of the stack of the calling thread, used to stop
+// the frame pointer walk before reading outside of the stack.
+static __thread uintptr_t _stack_end_ = 0;
+
+static uintptr_t stack_end()
+{
+	if(_stack_end_ != 0) return _stack_end_;
+	pthread_attr_t attr;
+	void* addr;
+	size_t size;
+	if(pthread_getattr_np(pthread_self(),&attr) != 0) return 0;
+	if(pthread_attr_getstack(&attr,&addr,&size) == 0)
+		_stack_end_ = (uintptr_t)addr + size;
+	pthread_attr_destroy(&attr);
+	return _stack_end_;
+}
+
+size_t __attribute__((noinline)) unwind_frame_pointer(void** buffer, size_t size)
+{
+	uintptr_t end = stack_end();
+	void** fp = (void**)__builtin_frame_address(0);
+	size_t i = 0;
+	while(i < size) {
+		// a frame is [previous frame pointer, return address]
+		if((uintptr_t)(fp+2) > end
+		|| ((uintptr_t)fp & (sizeof(void*)-1)) != 0) break;
+		void* ret = fp[1];
+		if(ret == NULL) break;
+		buffer[i++] = ret;
+		void** next = (void**)fp[0];
+		// frames must go up the stack
+		if(next <= fp) break;
+		fp = next;
+	}
+	return i;
+}
+
+#ifdef HAVE_LIBUNWIND
+size_t __attribute__((noinline)) unwind_libunwind(void** buffer, size_t size)
+{
+	unw_context_t context;
+	unw_cursor_t cursor;
+	if(unw_getcontext(&context) != 0) return 0;
+	if(unw_init_local(&cursor,&context) != 0) return 0;
+	size_t i = 0;
+	// the first step goes from this function to its caller
+	while(i < size && unw_step(&cursor) > 0) {
+		unw_word_t ip;
+		if(unw_get_reg(&cursor,UNW_REG_IP,&ip) != 0 || ip == 0) break;
+		buffer[i++] = (void*)ip;
+	}
+	return i;
+}
+#endif
+
+unwinder find_unwinder(const char* name)
+{
+	if(name == NULL) return NULL;
+	if(std::strcmp(name,"glibc") == 0) return unwind_glibc;
+	if(std::strcmp(name,"fp") == 0) return unwind_frame_pointer;
+#ifdef HAVE_LIBUNWIND
+	if(std::strcmp(name,"libunwind") == 0) return unwind_libunwind;
+#endif
+	return NULL;
+}
+
+}
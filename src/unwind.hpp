@@ -0,0 +1,79 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#ifndef OMNISCIO_UNWIND_H
+#define OMNISCIO_UNWIND_H
+
+#include <cstddef>
+
+namespace omniscio {
+
+/**
+ * An unwinder fills a buffer with the return addresses of the
+ * calling stack, starting with the caller of the unwinder,
+ * and returns the number of addresses written.
+ */
+typedef size_t (*unwinder)(void** buffer, size_t size);
+
+/**
+ * Unwinder based on glibc's backtrace (uses the DWARF information,
+ * works on any code but is the slowest one).
+ */
+size_t unwind_glibc(void** buffer, size_t size);
+
+/**
+ * Unwinder following the chain of frame pointers. Only valid if the
+ * application and the libraries between main and the I/O calls
+ * are compiled with -fno-omit-frame-pointer, the walk stops at the
+ * first frame that does not look like a frame.
+ */
+size_t unwind_frame_pointer(void** buffer, size_t size);
+
+#ifdef HAVE_LIBUNWIND
+/**
+ * Unwinder based on libunwind's local unwinding.
+ */
+size_t unwind_libunwind(void** buffer, size_t size);
+#endif
+
+/**
+ * Returns the unwinder corresponding to a name ("glibc", "fp" or
+ * "libunwind"), or NULL if the name is unknown or the unwinder is
+ * not available in this build.
+ */
+unwinder find_unwinder(const char* name);
+
+/**
+ * Unwinder used to build the traces, selected at initialization
+ * (see OMNISCIO_UNWINDER).
+ */
+extern unwinder unwind;
+
+}
+
+#endif
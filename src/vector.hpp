@@ -29,6 +29,7 @@
 #define OMNISCIO_VECTOR_H
 
 #include <fstream>
+#include <map>
 #include <vector>
 #include "omniscio.h"
 
@@ -45,15 +46,17 @@ class vector {
 
 	public:
 	
-	vector() {}
+	vector() : trash() {}
 
 	virtual ~vector() {}
 
 	const T& operator()(unsigned int i) const {
-		if(internal.size() >= i) {
+		typename std::map<unsigned int,T>::const_iterator it 
+			= internal.find(i);
+		if(it != internal.end())
+			return it->second;
+		else
 			return trash;
-		}
-		return internal[i];
 	}
 
 	T& operator()(unsigned int i) {
@@ -72,6 +75,21 @@ class vector {
 		OMNISCIO_UNTRACED_END;
 	}
 
+	/**
+	 * Renames the indices: i becomes m[i] (indices beyond the end
+	 * of m are left unchanged).
+	 */
+	void remap(const std::vector<int>& m) {
+		std::map<unsigned int,T> r;
+		typename std::map<unsigned int,T>::iterator it;
+		for(it = internal.begin(); it != internal.end(); it++) {
+			unsigned int i = it->first;
+			if(i < m.size()) i = m[i];
+			r[i] = it->second;
+		}
+		internal.swap(r);
+	}
+
 	bool defined(unsigned int i) const {
 		return internal.count(i) > 0;
 	}
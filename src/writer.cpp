@@ -0,0 +1,280 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "writer.hpp"
+
+namespace omniscio {
+
+#define SYNC_BUFFER_SIZE	(64*1024)
+
+static bool				_running_ = false;
+static bool				_stop_ = false;
+static pthread_t			_thread_;
+static size_t				_buffer_size_ = SYNC_BUFFER_SIZE;
+static long				_interval_ = 1000;
+static bool				_drop_ = true;
+static long long			_dropped_ = 0;
+// protects _buffers_, _handed_ and _stop_; _wake_ wakes up the writer
+// thread, _done_ the streams waiting for their back buffer
+static pthread_mutex_t			_lock_ = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t			_wake_ = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t			_done_ = PTHREAD_COND_INITIALIZER;
+static std::vector<log_buffer*>		_buffers_;
+static unsigned long			_handed_ = 0; // hand overs so far
+
+static void write_all(int fd, const char* data, size_t size)
+{
+	while(size > 0) {
+		long n = syscall(SYS_write,fd,data,size);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) return;
+		data += n;
+		size -= n;
+	}
+}
+
+log_buffer::log_buffer()
+: fd(-1), front(NULL), back(NULL), capacity(0), mark(NULL), back_size(0),
+  back_full(0), flush_requested(0), blocking(false) {}
+
+log_buffer::~log_buffer()
+{
+	close();
+}
+
+bool log_buffer::open(const char* filename, bool block)
+{
+	close();
+	fd = syscall(SYS_openat,AT_FDCWD,filename,
+			O_WRONLY | O_CREAT | O_TRUNC,0644);
+	if(fd < 0) return false;
+
+	capacity = _buffer_size_;
+	front = new char[capacity];
+	back = _running_ ? new char[capacity] : NULL;
+	setp(front,front+capacity);
+	mark = front;
+	back_size = 0;
+	back_full = 0;
+	flush_requested = 0;
+	blocking = block || not _drop_;
+
+	if(_running_) {
+		pthread_mutex_lock(&_lock_);
+		_buffers_.push_back(this);
+		pthread_mutex_unlock(&_lock_);
+	}
+	return true;
+}
+
+void log_buffer::close()
+{
+	if(fd < 0) return;
+
+	mark = pptr();
+	hand_over(true,false);
+	if(back != NULL) {
+		pthread_mutex_lock(&_lock_);
+		while(__atomic_load_n(&back_full,__ATOMIC_ACQUIRE))
+			pthread_cond_wait(&_done_,&_lock_);
+		_buffers_.erase(std::remove(_buffers_.begin(),_buffers_.end(),
+					this),_buffers_.end());
+		pthread_mutex_unlock(&_lock_);
+	}
+	syscall(SYS_close,fd);
+	fd = -1;
+	delete[] front;
+	delete[] back;
+	front = back = NULL;
+	setp(NULL,NULL);
+}
+
+/**
+ * Hands the complete records of the front buffer over to the writer
+ * thread, or writes them if there is no writer thread.
+ * \param[in] wait : wait for the back buffer if it is not written yet,
+ * otherwise nothing is done.
+ * \param[in] may_drop : when waiting, drop the records instead unless
+ * the buffer is blocking.
+ */
+void log_buffer::hand_over(bool wait, bool may_drop)
+{
+	__atomic_store_n(&flush_requested,0,__ATOMIC_RELAXED);
+	// without any complete record, everything goes
+	char* end = (mark > pbase()) ? mark : pptr();
+	size_t size = end - pbase();
+	size_t rest = pptr() - end;
+	if(size == 0) return;
+
+	if(back == NULL) {
+		write_all(fd,front,size);
+		std::memmove(front,end,rest);
+	} else {
+		bool busy = __atomic_load_n(&back_full,__ATOMIC_ACQUIRE);
+		if(busy && not wait) return;
+		if(busy && may_drop && not blocking) {
+			// the file system is late: losing records beats waiting
+			__atomic_fetch_add(&_dropped_,(long long)size,
+					__ATOMIC_RELAXED);
+			std::memmove(front,end,rest);
+		} else {
+			pthread_mutex_lock(&_lock_);
+			while(__atomic_load_n(&back_full,__ATOMIC_ACQUIRE))
+				pthread_cond_wait(&_done_,&_lock_);
+			std::swap(front,back);
+			std::memcpy(front,end,rest);
+			back_size = size;
+			__atomic_store_n(&back_full,1,__ATOMIC_RELEASE);
+			_handed_ += 1;
+			pthread_cond_signal(&_wake_);
+			pthread_mutex_unlock(&_lock_);
+		}
+	}
+	setp(front,front+capacity);
+	pbump((int)rest);
+	mark = front;
+}
+
+log_buffer::int_type log_buffer::overflow(int_type c)
+{
+	if(fd < 0) return traits_type::eof();
+	hand_over(true,true);
+	if(not traits_type::eq_int_type(c,traits_type::eof())) {
+		if(pptr() == epptr()) return traits_type::eof();
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+	}
+	return traits_type::not_eof(c);
+}
+
+int log_buffer::sync()
+{
+	if(fd < 0) return -1;
+	mark = pptr();
+	hand_over(false,false);
+	return 0;
+}
+
+void log_buffer::write_back()
+{
+	write_all(fd,back,back_size);
+	__atomic_store_n(&back_full,0,__ATOMIC_RELEASE);
+}
+
+static void* write_loop(void*)
+{
+	struct timespec last;
+	clock_gettime(CLOCK_MONOTONIC,&last);
+
+	pthread_mutex_lock(&_lock_);
+	while(true) {
+		unsigned long seen = _handed_;
+		bool written = false;
+		for(size_t i = 0; i < _buffers_.size(); i++) {
+			log_buffer* b = _buffers_[i];
+			if(not b->pending()) continue;
+			// the buffer cannot be closed before its back is written
+			pthread_mutex_unlock(&_lock_);
+			b->write_back();
+			pthread_mutex_lock(&_lock_);
+			written = true;
+		}
+		if(written) pthread_cond_broadcast(&_done_);
+
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC,&now);
+		long elapsed = (now.tv_sec - last.tv_sec)*1000
+			+ (now.tv_nsec - last.tv_nsec)/1000000;
+		if(elapsed >= _interval_) {
+			for(size_t i = 0; i < _buffers_.size(); i++)
+				_buffers_[i]->request_flush();
+			last = now;
+		}
+		if(written || _handed_ != seen) continue;
+		if(_stop_) break;
+
+		// woken up by hand overs, or after the interval
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME,&deadline);
+		long ms = std::max(_interval_ - elapsed,1L);
+		deadline.tv_sec += ms/1000;
+		deadline.tv_nsec += (ms%1000)*1000000;
+		if(deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec += 1;
+			deadline.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&_wake_,&_lock_,&deadline);
+	}
+	pthread_mutex_unlock(&_lock_);
+	return NULL;
+}
+
+void start_writer(size_t buffer_size, long interval, bool drop)
+{
+	if(_running_) return;
+	_buffer_size_ = std::max(buffer_size,(size_t)4096);
+	_interval_ = std::max(interval,1L);
+	_drop_ = drop;
+	_stop_ = false;
+
+	// signals are left to the application threads
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK,&all,&old);
+	_running_ = (pthread_create(&_thread_,NULL,write_loop,NULL) == 0);
+	pthread_sigmask(SIG_SETMASK,&old,NULL);
+	if(not _running_) _buffer_size_ = SYNC_BUFFER_SIZE;
+}
+
+void stop_writer()
+{
+	if(not _running_) return;
+	pthread_mutex_lock(&_lock_);
+	_stop_ = true;
+	pthread_cond_signal(&_wake_);
+	pthread_mutex_unlock(&_lock_);
+	pthread_join(_thread_,NULL);
+	_running_ = false;
+	_buffer_size_ = SYNC_BUFFER_SIZE;
+}
+
+long long writer_dropped()
+{
+	return __atomic_load_n(&_dropped_,__ATOMIC_RELAXED);
+}
+
+}
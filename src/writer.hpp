@@ -0,0 +1,207 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef OMNISCIO_WRITER_H
+#define OMNISCIO_WRITER_H
+
+#include <cstddef>
+#include <ostream>
+#include <streambuf>
+
+namespace omniscio {
+
+/**
+ * The log_buffer class is a stream buffer that writes a file through two
+ * in-memory buffers. The stream fills the front buffer. Once it is full,
+ * it becomes the back buffer and is written by the writer thread (see
+ * start_writer) with a single call, while the stream goes on in the other
+ * buffer. Without writer thread, the caller writes it.
+ *
+ * The stream marks the end of its records with commit: only complete
+ * records are handed over. When the front buffer fills up while the back
+ * one is still being written, its complete records are dropped instead of
+ * waiting for the file system, unless the buffer is blocking.
+ *
+ * The file is accessed with raw system calls, which the POSIX wrappers
+ * of Omnisc'IO do not see.
+ */
+class log_buffer : public std::streambuf {
+
+	private:
+
+	int		fd;
+	char*		front;
+	char*		back;
+	size_t		capacity;
+	char*		mark;		// end of the last complete record
+	size_t		back_size;	// bytes of back to write
+	int		back_full;	// back belongs to the writer thread
+	int		flush_requested;// set by the writer thread
+	bool		blocking;
+
+	log_buffer(const log_buffer&);
+	log_buffer& operator=(const log_buffer&);
+
+	void hand_over(bool wait, bool may_drop);
+
+	protected:
+
+	int_type overflow(int_type c);
+
+	int sync();
+
+	public:
+
+	log_buffer();
+
+	~log_buffer();
+
+	/**
+	 * Creates or truncates a file.
+	 * \param[in] filename : name of the file.
+	 * \param[in] block : wait for the file system rather than drop
+	 * records when both buffers are full.
+	 * \return true in case of success, false otherwise.
+	 */
+	bool open(const char* filename, bool block);
+
+	/**
+	 * Writes what remains in the buffers and closes the file.
+	 */
+	void close();
+
+	bool is_open() const {
+		return fd >= 0;
+	}
+
+	/**
+	 * Marks the end of a record: what the stream wrote so far can be
+	 * handed over to the writer thread.
+	 */
+	void commit() {
+		mark = pptr();
+		if(__atomic_load_n(&flush_requested,__ATOMIC_RELAXED))
+			hand_over(false,false);
+	}
+
+	/**
+	 * Writer thread side: whether the back buffer is full.
+	 */
+	bool pending() const {
+		return __atomic_load_n(&back_full,__ATOMIC_ACQUIRE);
+	}
+
+	/**
+	 * Writer thread side: writes the back buffer, which must be full.
+	 */
+	void write_back();
+
+	/**
+	 * Writer thread side: asks the stream to hand over its
+	 * complete records at the next commit.
+	 */
+	void request_flush() {
+		__atomic_store_n(&flush_requested,1,__ATOMIC_RELAXED);
+	}
+};
+
+/**
+ * The log_file class is an output file stream going through a
+ * log_buffer. It can be used in place of an std::ofstream.
+ */
+class log_file : public std::ostream {
+
+	private:
+
+	log_buffer	buffer;
+	bool		blocking;
+
+	public:
+
+	log_file() : std::ostream(NULL), blocking(false) {
+		init(&buffer);
+	}
+
+	/**
+	 * Creates or truncates a file. The mode is ignored, files are
+	 * always written in binary mode.
+	 */
+	void open(const char* filename,
+		std::ios_base::openmode /*mode*/ = std::ios_base::out) {
+		if(buffer.open(filename,blocking)) clear();
+		else setstate(std::ios_base::failbit);
+	}
+
+	void close() {
+		buffer.close();
+	}
+
+	bool is_open() const {
+		return buffer.is_open();
+	}
+
+	/**
+	 * See log_buffer::commit.
+	 */
+	void commit() {
+		buffer.commit();
+	}
+
+	/**
+	 * Records must not be dropped, for formats in which a record
+	 * depends on the previous ones. Must be called before open.
+	 */
+	void set_blocking(bool b) {
+		blocking = b;
+	}
+};
+
+/**
+ * Starts the writer thread, which writes the full buffers of all the
+ * log_files opened from now on.
+ * \param[in] buffer_size : size of each of the two buffers of a file.
+ * \param[in] interval : time (in ms) after which the records of each
+ * file are handed over even if its buffer is not full.
+ * \param[in] drop : drop records rather than wait when both buffers
+ * of a file are full.
+ */
+void start_writer(size_t buffer_size, long interval, bool drop);
+
+/**
+ * Writes the remaining full buffers and stops the writer thread.
+ * The log_files should be closed first.
+ */
+void stop_writer();
+
+/**
+ * Returns the number of bytes of records dropped so far.
+ */
+long long writer_dropped();
+
+}
+
+#endif
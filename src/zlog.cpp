@@ -0,0 +1,441 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <cmath>
+#include <cstring>
+#include <climits>
+#include "zlog.hpp"
+
+namespace omniscio {
+
+static const char 	ZLOG_MAGIC[8] 	= {'O','M','N','I','Z','L','O','G'};
+static const char 	ZLOG_END[8] 	= {'O','M','N','I','Z','E','N','D'};
+static const unsigned 	ZLOG_VERSION 	= 3;
+static const size_t 	ZLOG_HEADER 	= 12; // magic + version
+static const size_t 	ZLOG_TRAILER 	= 17; // empty chunk + count + magic
+
+// flags indicating which fields of an event were mispredicted
+enum {
+	ZLOG_OP		= 0x01,
+	ZLOG_API	= 0x02,
+	ZLOG_OFFSET	= 0x04,
+	ZLOG_SIZE	= 0x08,
+	ZLOG_FD		= 0x10,
+	ZLOG_RET	= 0x20,
+	ZLOG_NAME	= 0x40
+};
+
+static inline size_t put_varint(unsigned char* buf, unsigned long long v)
+{
+	size_t n = 0;
+	while(v >= 0x80) {
+		buf[n++] = (unsigned char)((v & 0x7f) | 0x80);
+		v >>= 7;
+	}
+	buf[n++] = (unsigned char)v;
+	return n;
+}
+
+static inline bool get_varint(std::istream& in, unsigned long long& v)
+{
+	v = 0;
+	for(int shift = 0; shift < 64; shift += 7) {
+		int c = in.get();
+		if(c == EOF) return false;
+		v |= (unsigned long long)(c & 0x7f) << shift;
+		if((c & 0x80) == 0) return true;
+	}
+	return false;
+}
+
+static inline unsigned long long zigzag(long long v)
+{
+	return ((unsigned long long)v << 1) ^ (unsigned long long)(v >> 63);
+}
+
+static inline long long unzigzag(unsigned long long v)
+{
+	return (long long)(v >> 1) ^ -(long long)(v & 1);
+}
+
+static inline void put_fixed(unsigned char* buf, unsigned long long v, size_t n)
+{
+	for(size_t i = 0; i < n; i++) buf[i] = (unsigned char)(v >> (8*i));
+}
+
+static inline unsigned long long get_fixed(const unsigned char* buf, size_t n)
+{
+	unsigned long long v = 0;
+	for(size_t i = 0; i < n; i++) v |= (unsigned long long)buf[i] << (8*i);
+	return v;
+}
+
+static inline long long to_ns(omniscio_date d)
+{
+	return (long long)std::floor(d*1e9 + 0.5);
+}
+
+zlog_model::zlog_model()
+: prev_sym(0), prev_offset(0), prev_size(0), prev_end(0) {}
+
+void zlog_model::predict(int sym, event& e, long long& start, long long& end)
+{
+	long long duration = 0;
+	std::map<int,last_event>::const_iterator l = last.find(sym);
+	if(l != last.end()) {
+		e.op 	= l->second.op;
+		e.api 	= l->second.api;
+		e.fd 	= l->second.fd;
+		e.ret 	= l->second.ret;
+		e.name 	= l->second.named ? l->second.name.c_str() : NULL;
+		duration = l->second.duration;
+	} else {
+		e.op = e.api = e.ret = 0;
+		e.fd = 0;
+		e.name = NULL;
+	}
+
+	e.size = sizes.defined(sym) ? sizes(sym).predict() : 0;
+
+	offset_op op;
+	if(offsets.defined(prev_sym,sym)) op = offsets(prev_sym,sym).predict();
+	e.offset = (omniscio_offset)op.get_offset_after(prev_offset,prev_size);
+
+	long long gap = 0;
+	std::map<std::pair<int,int>,long long>::const_iterator g
+		= gaps.find(std::make_pair(prev_sym,sym));
+	if(g != gaps.end()) gap = g->second;
+	start = prev_end + gap;
+	end = start + duration;
+}
+
+void zlog_model::update(const event& e, long long start, long long end)
+{
+	last_event& l = last[e.sym];
+	l.op 		= e.op;
+	l.api 		= e.api;
+	l.fd 		= e.fd;
+	l.ret 		= e.ret;
+	l.duration 	= end - start;
+	l.named 	= (e.name != NULL);
+	// the name may be the predicted one
+	if(e.name != NULL && e.name != l.name.c_str()) l.name = e.name;
+
+	gaps[std::make_pair(prev_sym,e.sym)] = start - prev_end;
+
+	sizes(e.sym).input(e.size);
+
+	if(prev_sym != 0) {
+		offset_op op;
+		if(prev_offset + prev_size != e.offset) {
+			if(e.offset == 0) {
+				op = offset_op(0,offset_op::ABSOLUTE);
+			} else {
+				long relative = e.offset - (prev_offset + prev_size);
+				op = offset_op(relative,offset_op::RELATIVE);
+			}
+		}
+		offsets(prev_sym,e.sym).input(op);
+	}
+
+	prev_sym 	= e.sym;
+	prev_offset 	= e.offset;
+	prev_size 	= e.size;
+	prev_end 	= end;
+}
+
+zlog_encoder::zlog_encoder()
+: out(NULL), grammar(NULL), chunk_size(0), chunk_events(0), num_events(0) {}
+
+zlog_encoder::~zlog_encoder()
+{
+	delete grammar;
+}
+
+void zlog_encoder::put(const unsigned char* data, size_t size)
+{
+	out->write((const char*)data,size);
+}
+
+void zlog_encoder::open(std::ostream& o, size_t chunk)
+{
+	unsigned char header[ZLOG_HEADER];
+	std::memcpy(header,ZLOG_MAGIC,8);
+	put_fixed(header+8,ZLOG_VERSION,4);
+	out = &o;
+	delete grammar;
+	grammar = new sequitur::oracle();
+	residuals.clear();
+	chunk_size = chunk == 0 ? 1 : chunk;
+	chunk_events = 0;
+	num_events = 0;
+	put(header,ZLOG_HEADER);
+}
+
+void zlog_encoder::encode(const event& e)
+{
+	if(out == NULL) return;
+
+	event p;
+	long long pstart, pend;
+	model.predict(e.sym,p,pstart,pend);
+
+	long long start = to_ns(e.start);
+	long long end 	= to_ns(e.end);
+
+	unsigned char buf[128];
+	unsigned char flags = 0;
+	size_t n = 1;
+	if(e.op != p.op) {
+		flags |= ZLOG_OP;
+		n += put_varint(buf+n,e.op);
+	}
+	if(e.api != p.api) {
+		flags |= ZLOG_API;
+		n += put_varint(buf+n,e.api);
+	}
+	if(e.offset != p.offset) {
+		flags |= ZLOG_OFFSET;
+		n += put_varint(buf+n,zigzag((long long)(e.offset - p.offset)));
+	}
+	if(e.size != p.size) {
+		flags |= ZLOG_SIZE;
+		n += put_varint(buf+n,zigzag((long long)(e.size - p.size)));
+	}
+	if(e.fd != p.fd) {
+		flags |= ZLOG_FD;
+		n += put_varint(buf+n,e.fd);
+	}
+	if(e.ret != p.ret) {
+		flags |= ZLOG_RET;
+		n += put_varint(buf+n,zigzag(e.ret));
+	}
+	// the name is stored when it differs from the one of the last
+	// operation of the call site (0: no name, its length + 1 otherwise)
+	size_t len = 0;
+	if((e.name == NULL) != (p.name == NULL)
+	|| (e.name != NULL && std::strcmp(e.name,p.name) != 0)) {
+		flags |= ZLOG_NAME;
+		len = e.name == NULL ? 0 : std::strlen(e.name);
+		n += put_varint(buf+n,e.name == NULL ? 0 : len+1);
+	}
+	n += put_varint(buf+n,zigzag(start - pstart));
+	n += put_varint(buf+n,zigzag((end - start) - (pend - pstart)));
+	buf[0] = flags;
+
+	residuals.append((const char*)buf,n);
+	if(len != 0) residuals.append(e.name,len);
+
+	grammar->input(e.sym);
+	model.update(e,start,end);
+	num_events += 1;
+	chunk_events += 1;
+	if(chunk_events == chunk_size) flush_chunk();
+}
+
+void zlog_encoder::flush_chunk()
+{
+	if(chunk_events == 0) return;
+
+	std::vector<std::vector<sequitur::ulong> > rules;
+	grammar->export_rules(rules);
+
+	unsigned char buf[16];
+	put(buf,put_varint(buf,chunk_events));
+	put(buf,put_varint(buf,rules.size()));
+	for(size_t i = 0; i < rules.size(); i++) {
+		put(buf,put_varint(buf,rules[i].size()));
+		for(size_t j = 0; j < rules[i].size(); j++) {
+			put(buf,put_varint(buf,rules[i][j]));
+		}
+	}
+	put((const unsigned char*)residuals.data(),residuals.size());
+
+	// the next chunk starts a new grammar, the model goes on
+	delete grammar;
+	grammar = new sequitur::oracle();
+	residuals.clear();
+	chunk_events = 0;
+}
+
+void zlog_encoder::close()
+{
+	if(out == NULL) return;
+
+	flush_chunk();
+
+	unsigned char trailer[ZLOG_TRAILER];
+	trailer[0] = 0;
+	put_fixed(trailer+1,num_events,8);
+	std::memcpy(trailer+9,ZLOG_END,8);
+	put(trailer,ZLOG_TRAILER);
+
+	out->flush();
+	out = NULL;
+}
+
+zlog_decoder::zlog_decoder()
+: in(NULL), remaining(0) {}
+
+bool zlog_decoder::probe(std::istream& i)
+{
+	char magic[8];
+	std::streampos pos = i.tellg();
+	i.read(magic,8);
+	bool result = i.good() && (std::memcmp(magic,ZLOG_MAGIC,8) == 0);
+	i.clear();
+	i.seekg(pos);
+	return result;
+}
+
+bool zlog_decoder::open(std::istream& i)
+{
+	in = &i;
+	remaining = 0;
+	rules.clear();
+	stack.clear();
+
+	unsigned char header[ZLOG_HEADER];
+	i.read((char*)header,ZLOG_HEADER);
+	return i.good() && std::memcmp(header,ZLOG_MAGIC,8) == 0
+		&& get_fixed(header+8,4) == ZLOG_VERSION;
+}
+
+bool zlog_decoder::next_chunk()
+{
+	// a grammar has at most as many rules, and rules at most as
+	// many symbols, as the events it generates. The vectors only
+	// grow with what is read, so a corrupt count cannot exhaust
+	// the memory.
+	unsigned long long count, nrules, len, sym;
+	if(not get_varint(*in,count) || count == 0) return false;
+	if(not get_varint(*in,nrules) || nrules == 0 || nrules > count)
+		return false;
+	rules.clear();
+	for(size_t r = 0; r < nrules; r++) {
+		if(not get_varint(*in,len) || len > count) return false;
+		rules.push_back(std::vector<sequitur::ulong>());
+		for(size_t j = 0; j < len; j++) {
+			if(not get_varint(*in,sym)) return false;
+			if(sym % 2 == 0 && sym/2 >= nrules) return false;
+			rules[r].push_back(sym);
+		}
+	}
+	stack.clear();
+	stack.push_back(std::make_pair(0,0));
+	remaining = count;
+	return true;
+}
+
+int zlog_decoder::next_symbol()
+{
+	while(not stack.empty()) {
+		std::pair<size_t,size_t>& top = stack.back();
+		if(top.second == rules[top.first].size()) {
+			stack.pop_back();
+			continue;
+		}
+		sequitur::ulong s = rules[top.first][top.second];
+		top.second += 1;
+		if(s % 2 == 1) return (int)(s/2);
+		// deeper than the number of rules: a rule contains
+		// itself, the log is corrupt
+		if(stack.size() == rules.size()) return -1;
+		stack.push_back(std::make_pair(s/2,0));
+	}
+	return -1;
+}
+
+bool zlog_decoder::next(event& e)
+{
+	if(in == NULL) return false;
+	if(remaining == 0 && not next_chunk()) {
+		in = NULL;
+		return false;
+	}
+
+	int sym = next_symbol();
+	if(sym < 0) {
+		in = NULL;
+		return false;
+	}
+	int flags = in->get();
+	if(flags == EOF) return false;
+
+	long long pstart, pend;
+	model.predict(sym,e,pstart,pend);
+	e.sym = sym;
+
+	unsigned long long v;
+	if(flags & ZLOG_OP) {
+		if(not get_varint(*in,v)) return false;
+		e.op = (int)v;
+	}
+	if(flags & ZLOG_API) {
+		if(not get_varint(*in,v)) return false;
+		e.api = (int)v;
+	}
+	if(flags & ZLOG_OFFSET) {
+		if(not get_varint(*in,v)) return false;
+		e.offset += (omniscio_offset)unzigzag(v);
+	}
+	if(flags & ZLOG_SIZE) {
+		if(not get_varint(*in,v)) return false;
+		e.size += (omniscio_size)unzigzag(v);
+	}
+	if(flags & ZLOG_FD) {
+		if(not get_varint(*in,v)) return false;
+		e.fd = (unsigned long)v;
+	}
+	if(flags & ZLOG_RET) {
+		if(not get_varint(*in,v)) return false;
+		e.ret = (int)unzigzag(v);
+	}
+	unsigned long long len = 0;
+	if((flags & ZLOG_NAME)
+	&& (not get_varint(*in,len) || len > PATH_MAX+1)) return false;
+	if(not get_varint(*in,v)) return false;
+	long long start = pstart + unzigzag(v);
+	if(not get_varint(*in,v)) return false;
+	long long end = start + (pend - pstart) + unzigzag(v);
+	// the name, if any, follows the record
+	if((flags & ZLOG_NAME) && len == 0) {
+		e.name = NULL;
+	} else if(flags & ZLOG_NAME) {
+		name.resize(len-1);
+		if(len > 1) in->read(&name[0],len-1);
+		e.name = name.c_str();
+	}
+	e.start = (omniscio_date)start/1e9;
+	e.end = (omniscio_date)end/1e9;
+
+	model.update(e,start,end);
+	remaining -= 1;
+	return in->good();
+}
+
+}
@@ -0,0 +1,199 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef OMNISCIO_ZLOG_H
+#define OMNISCIO_ZLOG_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include "event.hpp"
+#include "matrix.hpp"
+#include "vector.hpp"
+#include "sizes.hpp"
+#include "offsets.hpp"
+#include "sequitur/oracle.hpp"
+
+namespace omniscio {
+
+/**
+ * The zlog_model class holds the predictors shared by the encoder
+ * and the decoder of compressed logs. Both sides feed it with the
+ * same events in the same order, so the encoder only has to store
+ * what the model mispredicted. Dates are handled in nanoseconds.
+ */
+class zlog_model {
+
+	private:
+
+	struct last_event {
+		int 		op;
+		int 		api;
+		unsigned long 	fd;
+		int 		ret;
+		long long 	duration;
+		bool 		named;	// the operation had a file name
+		std::string 	name;
+	};
+
+	vector<size_tracker> 			sizes;
+	matrix<offset_tracker> 			offsets;
+	std::map<int,last_event> 		last;
+	std::map<std::pair<int,int>,long long> 	gaps;
+
+	int 			prev_sym;
+	omniscio_offset 	prev_offset;
+	omniscio_size 		prev_size;
+	long long 		prev_end;
+
+	public:
+
+	zlog_model();
+
+	/**
+	 * Fills the fields of e (except sym) with the values predicted
+	 * for the next operation, given its symbol. The name, if not
+	 * NULL, remains valid until the next call to update.
+	 */
+	void predict(int sym, event& e, long long& start, long long& end);
+
+	/**
+	 * Updates the model with the actual operation.
+	 */
+	void update(const event& e, long long start, long long end);
+};
+
+/**
+ * The zlog_encoder class writes a stream of events in the compressed
+ * log format: the sequence of symbols is stored as the Sequitur
+ * grammar that generates it, and each event only stores the fields
+ * that the zlog_model could not predict.
+ *
+ * File layout: header, chunks, trailer. Each chunk holds a number of
+ * events, the grammar of their symbols and their residuals, so that
+ * the log of a process that did not call close() can still be read up
+ * to its last complete chunk.
+ */
+class zlog_encoder {
+
+	private:
+
+	std::ostream* 		out;
+	sequitur::oracle* 	grammar;
+	zlog_model 		model;
+	std::string 		residuals;
+	size_t 			chunk_size;
+	unsigned long long 	chunk_events;
+	unsigned long long 	num_events;
+
+	void put(const unsigned char* data, size_t size);
+
+	/**
+	 * Writes the events encoded since the last chunk, if any.
+	 */
+	void flush_chunk();
+
+	public:
+
+	zlog_encoder();
+
+	~zlog_encoder();
+
+	/**
+	 * Starts writing a compressed log in the provided stream.
+	 * \param[in] o : stream to write to.
+	 * \param[in] chunk : number of events per chunk.
+	 */
+	void open(std::ostream& o, size_t chunk = 4096);
+
+	/**
+	 * Appends an event to the log.
+	 */
+	void encode(const event& e);
+
+	/**
+	 * Writes the last chunk and the trailer. The stream is not closed.
+	 */
+	void close();
+
+	bool is_open() const {
+		return out != NULL;
+	}
+};
+
+/**
+ * The zlog_decoder class streams the events stored in a compressed log.
+ * Sizes and references read from the log are checked, a corrupt log
+ * only ends the stream.
+ */
+class zlog_decoder {
+
+	private:
+
+	std::istream* 					in;
+	std::vector<std::vector<sequitur::ulong> > 	rules;
+	std::vector<std::pair<size_t,size_t> > 		stack;
+	zlog_model 					model;
+	unsigned long long 				remaining;
+	std::string 					name;
+
+	int next_symbol();
+
+	/**
+	 * Reads the number of events and the grammar of the next chunk.
+	 * \return false at the trailer or if the chunk is incomplete.
+	 */
+	bool next_chunk();
+
+	public:
+
+	zlog_decoder();
+
+	/**
+	 * Checks whether the stream contains a compressed log.
+	 * The position in the stream is restored.
+	 */
+	static bool probe(std::istream& i);
+
+	/**
+	 * Checks the header of the stream and prepares to read events.
+	 * \return true in case of success, false otherwise.
+	 */
+	bool open(std::istream& i);
+
+	/**
+	 * Reads the next event. The name field, if not NULL, remains
+	 * valid until the next call.
+	 * \return false when no more event can be read.
+	 */
+	bool next(event& e);
+};
+
+}
+
+#endif
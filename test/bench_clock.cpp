@@ -0,0 +1,139 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <time.h>
+#include <mpi.h>
+#include "clock.hpp"
+
+using namespace omniscio;
+
+// Measures the cost of dating an operation with each available clock:
+// one read, and one event as traced before (4 calls to MPI_Wtime) and
+// now (one read at each boundary). Also shows the smallest step seen
+// and how far each clock drifted from CLOCK_MONOTONIC.
+// Usage: bench_clock [iterations]
+
+static volatile double sink;
+
+static double monotonic()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static double __attribute__((noinline)) bench_read(clock_reader c, 
+							long iterations)
+{
+	double start = monotonic();
+	for(long i = 0; i < iterations; i++) sink = c();
+	return (monotonic() - start)*1e9/iterations;
+}
+
+// dates of an event: start and end, the model's current and previous
+static double __attribute__((noinline)) bench_event_mpi(long iterations)
+{
+	double start = monotonic();
+	for(long i = 0; i < iterations; i++) {
+		double current = MPI_Wtime();
+		double ev_start = MPI_Wtime();
+		double ev_end = MPI_Wtime();
+		double previous = MPI_Wtime();
+		sink = current + ev_start + ev_end + previous;
+	}
+	return (monotonic() - start)*1e9/iterations;
+}
+
+static double __attribute__((noinline)) bench_event(clock_reader c, 
+							long iterations)
+{
+	double start = monotonic();
+	for(long i = 0; i < iterations; i++) {
+		double ev_start = c();
+		double ev_end = c();
+		sink = ev_start + ev_end;
+	}
+	return (monotonic() - start)*1e9/iterations;
+}
+
+static double resolution(clock_reader c)
+{
+	double best = 1.0;
+	for(int i = 0; i < 1000; i++) {
+		double a = c(), b = c();
+		while(b == a) b = c();
+		if(b - a < best) best = b - a;
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	MPI_Init(&argc,&argv);
+	long iterations = argc > 1 ? std::atol(argv[1]) : 1000000;
+
+	const char* names[] = { "mpi", "raw", "coarse", "tsc" };
+
+	// dates of each clock and of CLOCK_MONOTONIC before the benchmarks
+	clock_reader clocks[4];
+	double starts[4], monotonic_starts[4];
+	for(int i = 0; i < 4; i++) {
+		clocks[i] = find_clock(names[i]);
+		monotonic_starts[i] = monotonic();
+		starts[i] = clocks[i] != NULL ? clocks[i]() : 0.0;
+	}
+
+	std::cout << std::setw(12) << "MPI_Wtime x4" << ": "
+		  << std::fixed << std::setprecision(1) 
+		  << bench_event_mpi(iterations) << " ns/event" << std::endl;
+
+	for(int i = 0; i < 4; i++) {
+		clock_reader c = clocks[i];
+		if(c == NULL) {
+			std::cout << std::setw(12) << names[i]
+				  << ": not available" << std::endl;
+			continue;
+		}
+		double read = bench_read(c,iterations);
+		double event = bench_event(c,iterations);
+		double step = resolution(c);
+		double drift = (c() - starts[i]) 
+			     - (monotonic() - monotonic_starts[i]);
+		std::cout << std::setw(12) << names[i] << ": "
+			  << std::fixed << std::setprecision(1) 
+			  << read << " ns/read, " << event << " ns/event, "
+			  << step*1e9 << " ns step, "
+			  << drift*1e6 << " us drift" << std::endl;
+	}
+
+	MPI_Finalize();
+	return 0;
+}
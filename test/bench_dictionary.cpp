@@ -0,0 +1,99 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+#include <time.h>
+#include "dictionary.hpp"
+
+using namespace omniscio;
+
+extern "C" {
+	__thread int omniscio_untraced = 0;
+}
+
+// Measures the cost of looking up known call stacks in the dictionary:
+// the given number of call sites, whose stacks have the given depth and
+// share their outer frames, are inserted once then looked up in a
+// random order.
+// Usage: bench_dictionary [sites] [depth] [iterations]
+
+typedef std::vector<void*> stack;
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// the outer half of the frames is the same for all the call sites,
+// as when the I/O calls are made from a few functions of a code
+static stack make_stack(int site, int depth)
+{
+	stack s;
+	for(int j = 0; j < depth; j++) {
+		long frame = j < depth/2 ? 0x400000 + 0x1000*site + 16*j
+					 : 0x800000 + 16*j;
+		s.push_back((void*)frame);
+	}
+	return s;
+}
+
+int main(int argc, char** argv)
+{
+	int sites = argc > 1 ? std::atoi(argv[1]) : 300;
+	int depth = argc > 2 ? std::atoi(argv[2]) : 30;
+	long iterations = argc > 3 ? std::atol(argv[3]) : 1000000;
+
+	std::vector<stack> stacks;
+	for(int i = 0; i < sites; i++) stacks.push_back(make_stack(i,depth));
+	std::vector<int> order(iterations);
+	srand(1);
+	for(long i = 0; i < iterations; i++) order[i] = rand() % sites;
+
+	// static, as in omniscio.cpp
+	static dictionary<void*,int> d;
+	for(int i = 0; i < sites; i++)
+		d.insert(stacks[i].begin(),stacks[i].end());
+
+	long sum = 0;
+	double start = now();
+	for(long i = 0; i < iterations; i++) {
+		const stack& s = stacks[order[i]];
+		sum += d.insert(s.begin(),s.end());
+	}
+	double ns = (now() - start)*1e9/iterations;
+
+	std::cout << sites << " call sites of " << depth << " frames: "
+		  << std::fixed << std::setprecision(1) << ns
+		  << " ns/lookup (" << sum << ")" << std::endl;
+	return 0;
+}
@@ -0,0 +1,109 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <time.h>
+#include "unwind.hpp"
+
+using namespace omniscio;
+
+// Measures the cost of capturing a stack with each available unwinder,
+// at a given depth below main.
+// Usage: bench_unwind [depth] [iterations]
+
+#define MAX_FRAMES 256
+
+static void* buffer[MAX_FRAMES];
+static size_t frames;
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static double __attribute__((noinline)) bench(unwinder u, long iterations)
+{
+	double start = now();
+	for(long i = 0; i < iterations; i++) {
+		frames = u(buffer,MAX_FRAMES);
+	}
+	return (now() - start)*1e9/iterations;
+}
+
+static double __attribute__((noinline)) recurse(int depth, unwinder u, long iterations)
+{
+	if(depth > 0) {
+		double r = recurse(depth-1,u,iterations);
+		// prevents the compiler from turning the recursion into a loop
+		__asm__ __volatile__("" ::: "memory");
+		return r;
+	}
+	return bench(u,iterations);
+}
+
+int main(int argc, char** argv)
+{
+	int depth = argc > 1 ? std::atoi(argv[1]) : 20;
+	long iterations = argc > 2 ? std::atol(argv[2]) : 100000;
+
+	const char* names[] = { "glibc", "fp", "libunwind" };
+	void* reference[MAX_FRAMES];
+	size_t reference_frames = 0;
+
+	for(int i = 0; i < 3; i++) {
+		unwinder u = find_unwinder(names[i]);
+		if(u == NULL) {
+			std::cout << std::setw(10) << names[i]
+				  << ": not available" << std::endl;
+			continue;
+		}
+		// warm-up (loads libgcc_s for glibc)
+		recurse(depth,u,1);
+		double ns = recurse(depth,u,iterations);
+
+		// compares the frames with the ones found by the first unwinder
+		size_t same = 0;
+		if(i == 0) {
+			reference_frames = frames;
+			for(size_t j = 0; j < frames; j++)
+				reference[j] = buffer[j];
+		}
+		while(same < frames && same < reference_frames
+		   && buffer[same] == reference[same]) same++;
+
+		std::cout << std::setw(10) << names[i] << ": "
+			  << std::fixed << std::setprecision(1) << ns
+			  << " ns/stack, " << frames << " frames ("
+			  << same << " identical to glibc)" << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,112 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <cstdlib>
+#include <mpi.h>
+#include "omniscio.h"
+#include "test_common.hpp"
+
+// Writes through two levels of helpers from a first caller until the
+// call site cache trusts its key, then in turn from the first caller
+// and from a second one, each to its own file. The key must reach the
+// callers, so that the second one gets its own symbol: after a write
+// from one of them, the next write is predicted on the file of the other.
+// Usage: test_callsite [iterations]
+
+__attribute__((noinline)) static void write_record(omniscio_file f, long i)
+{
+	omniscio_write_start(f,i*100,100);
+	omniscio_write_end(0);
+}
+
+__attribute__((noinline)) static void helper(omniscio_file f, long i)
+{
+	write_record(f,i);
+}
+
+__attribute__((noinline)) static void caller_a(omniscio_file f, long i)
+{
+	helper(f,i);
+}
+
+__attribute__((noinline)) static void caller_b(omniscio_file f, long i)
+{
+	helper(f,i);
+}
+
+#define CONFIRMATIONS 8
+#define WARMUP 10
+
+int main(int argc, char** argv)
+{
+	long iterations = argc > 1 ? std::atol(argv[1]) : 50;
+
+	setup_test("callsite");
+	unsetenv("OMNISCIO_CALLSITE_CACHE");
+	unsetenv("OMNISCIO_STACK_DEPTH");
+
+	MPI_Init(&argc,&argv);
+
+	omniscio_file a, b;
+	omniscio_file_from_posix(&a,5);
+	omniscio_file_from_posix(&b,6);
+	omniscio_open_start("a.dat",OMNISCIO_POSIX);
+	omniscio_open_end(0,a);
+	omniscio_open_start("b.dat",OMNISCIO_POSIX);
+	omniscio_open_end(0,b);
+
+	for(long i = 0; i < CONFIRMATIONS; i++) caller_a(a,i);
+
+	long misses = 0;
+	for(long i = 0; i < iterations; i++) {
+		caller_a(a,i);
+		if(i > WARMUP && not predicted_on(b)) misses++;
+		caller_b(b,i);
+		if(i > WARMUP && not predicted_on(a)) misses++;
+	}
+
+	omniscio_stats s;
+	omniscio_get_stats(&s);
+
+	MPI_Finalize();
+
+	int failures = 0;
+	if(misses != 0) {
+		std::cerr << misses << " writes predicted on the wrong file"
+			  << std::endl;
+		failures++;
+	}
+	// the cache must still be used once both keys are trusted
+	if(s.callsite_hits == 0) {
+		std::cerr << "no call site found in the cache" << std::endl;
+		failures++;
+	}
+	std::cout << (failures == 0 ? "OK" : "FAILED") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
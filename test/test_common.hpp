@@ -0,0 +1,85 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef OMNISCIO_TEST_COMMON_H
+#define OMNISCIO_TEST_COMMON_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <ftw.h>
+#include "omniscio.h"
+
+// Helpers of the tests that trace operations through Omnisc'IO.
+
+// directory created by setup_test, removed at exit
+static std::string _test_dir_;
+
+inline int remove_entry(const char* path, const struct stat*, int,
+			struct FTW*)
+{
+	return std::remove(path);
+}
+
+inline void remove_test_dir()
+{
+	if(not _test_dir_.empty())
+		nftw(_test_dir_.c_str(),remove_entry,16,FTW_DEPTH | FTW_PHYS);
+}
+
+// Sets the environment of a test, before MPI_Init: the logs go to a new
+// temporary directory, removed at exit, unless OMNISCIO_DIRECTORY is set
+// (or always if own is true), and the operations are learned by the
+// calling thread so that the predictions queried follow them.
+// Returns the directory of the logs, empty if it could not be created.
+inline std::string setup_test(const char* name, bool own = false)
+{
+	unsetenv("OMNISCIO_ASYNC");
+	const char* set = getenv("OMNISCIO_DIRECTORY");
+	if(set != NULL && not own) return set;
+
+	std::string templ = std::string("/tmp/omniscio-") + name + "-XXXXXX";
+	std::vector<char> dir(templ.begin(),templ.end());
+	dir.push_back('\0');
+	if(mkdtemp(&dir[0]) == NULL) return "";
+	_test_dir_ = &dir[0];
+	std::atexit(remove_test_dir);
+	setenv("OMNISCIO_DIRECTORY",&dir[0],1);
+	return _test_dir_;
+}
+
+// checks that the most probable next operation is on the given file
+inline bool predicted_on(const omniscio_file& f)
+{
+	omniscio_req buf[1];
+	int n = 0;
+	omniscio_next_into(buf,1,0.0,&n);
+	return n == 1 && buf[0].fh.handle.posix == f.handle.posix;
+}
+
+#endif
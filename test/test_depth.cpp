@@ -0,0 +1,89 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <cstdlib>
+#include <mpi.h>
+#include "omniscio.h"
+#include "test_common.hpp"
+
+// Writes in turn from two call sites, each to its own file, keeping a
+// single frame of each call stack (OMNISCIO_STACK_DEPTH=1, without the
+// call site cache). The frames of Omnisc'IO must not count, so that the
+// two call sites get two symbols: after a write from one of them, the
+// next write is predicted on the file of the other.
+// Usage: test_depth [iterations]
+
+__attribute__((noinline)) static void site_a(omniscio_file f, long i)
+{
+	omniscio_write_start(f,i*100,100);
+	omniscio_write_end(0);
+}
+
+__attribute__((noinline)) static void site_b(omniscio_file f, long i)
+{
+	omniscio_write_start(f,i*200,200);
+	omniscio_write_end(0);
+}
+
+#define WARMUP 10
+
+int main(int argc, char** argv)
+{
+	long iterations = argc > 1 ? std::atol(argv[1]) : 50;
+
+	setup_test("depth");
+	setenv("OMNISCIO_STACK_DEPTH","1",1);
+	setenv("OMNISCIO_CALLSITE_CACHE","0",1);
+
+	MPI_Init(&argc,&argv);
+
+	omniscio_file a, b;
+	omniscio_file_from_posix(&a,5);
+	omniscio_file_from_posix(&b,6);
+	omniscio_open_start("a.dat",OMNISCIO_POSIX);
+	omniscio_open_end(0,a);
+	omniscio_open_start("b.dat",OMNISCIO_POSIX);
+	omniscio_open_end(0,b);
+
+	long misses = 0;
+	for(long i = 0; i < iterations; i++) {
+		site_a(a,i);
+		if(i > WARMUP && not predicted_on(b)) misses++;
+		site_b(b,i);
+		if(i > WARMUP && not predicted_on(a)) misses++;
+	}
+
+	MPI_Finalize();
+
+	if(misses != 0)
+		std::cerr << misses << " writes predicted on the wrong file"
+			  << std::endl;
+	std::cout << (misses == 0 ? "OK" : "FAILED") << std::endl;
+	return misses == 0 ? 0 : 1;
+}
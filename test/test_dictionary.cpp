@@ -0,0 +1,295 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <algorithm>
+#include "dictionary.hpp"
+
+using namespace omniscio;
+
+extern "C" {
+	__thread int omniscio_untraced = 0;
+}
+
+// Saves a dictionary, loads it in another one and checks that the
+// known sequences keep their identifiers and that new ones are
+// numbered from next_index(). Files whose table points outside of the
+// letters are rejected. Sequences whose fingerprints are all the same
+// must still be told apart by comparing their letters.
+// Usage: test_dictionary [file]
+
+typedef dictionary<long,int> dict;
+
+#define NUM_SEQ 100
+
+// the i-th sequence, of 1 to 8 letters
+static std::vector<long> sequence(int i)
+{
+	std::vector<long> s;
+	for(int j = 0; j <= i % 8; j++) s.push_back(1000*i + j);
+	return s;
+}
+
+static int add(dict& d, int i)
+{
+	std::vector<long> s = sequence(i);
+	return d.insert(s.begin(),s.end());
+}
+
+// letter whose fingerprint does not depend on its value
+struct colliding {
+	long value;
+
+	bool operator==(const colliding& other) const {
+		return value == other.value;
+	}
+
+	bool operator<(const colliding& other) const {
+		return value < other.value;
+	}
+};
+
+namespace omniscio {
+template<>
+struct fingerprint<colliding> {
+	uint64_t operator()(uint64_t h, const colliding&) const {
+		return h;
+	}
+};
+}
+
+// the i-th sequence of colliding letters: prefixes of each other,
+// or of the same length and only different in their last letter
+static int add_colliding(dictionary<colliding,int>& d, int i)
+{
+	std::vector<colliding> s(1 + i % 4);
+	for(size_t j = 0; j < s.size(); j++) s[j].value = j;
+	s.back().value = i;
+	return d.insert(s.begin(),s.end());
+}
+
+static int check_collisions(const std::string& filename)
+{
+	int failures = 0;
+	dictionary<colliding,int> d;
+	std::vector<int> ids;
+	for(int i = 0; i < NUM_SEQ; i++) {
+		int id = add_colliding(d,i);
+		if(std::find(ids.begin(),ids.end(),id) != ids.end()) {
+			std::cout << "colliding sequence " << i << " got the "
+				  << "identifier of another one" << std::endl;
+			failures++;
+		}
+		ids.push_back(id);
+	}
+	for(int i = 0; i < NUM_SEQ; i++) {
+		if(add_colliding(d,i) != ids[i]) {
+			std::cout << "colliding sequence " << i << " not found"
+				  << std::endl;
+			failures++;
+		}
+	}
+
+	// same in the table of a loaded file
+	dictionary<colliding,int> loaded;
+	if(not d.save(filename) || not loaded.load(filename)) {
+		std::cout << "could not save and load colliding sequences"
+			  << std::endl;
+		return failures + 1;
+	}
+	for(int i = NUM_SEQ-1; i >= 0; i--) {
+		if(add_colliding(loaded,i) != ids[i]) {
+			std::cout << "loaded colliding sequence " << i
+				  << " not found" << std::endl;
+			failures++;
+		}
+	}
+	if(add_colliding(loaded,NUM_SEQ) != d.next_index()) {
+		std::cout << "new colliding sequence not numbered from "
+			  << d.next_index() << std::endl;
+		failures++;
+	}
+	return failures;
+}
+
+// offsets in the binary file, see file_header and stored_slot
+#define HEADER_SIZE	40
+#define SLOT_SIZE	32
+#define NUM_SLOTS	16	// uint64_t
+#define NUM_LETTERS	24	// uint64_t
+#define SLOT_OFFSET	8	// uint64_t
+#define SLOT_LENGTH	16	// uint64_t
+#define SLOT_INDEX	24	// int64_t
+
+static std::string read_file(const std::string& filename)
+{
+	std::ifstream in(filename.c_str(),
+		std::ios_base::in | std::ios_base::binary);
+	return std::string((std::istreambuf_iterator<char>(in)),
+			   std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string& filename, const std::string& data)
+{
+	std::ofstream out(filename.c_str(),
+		std::ios_base::out | std::ios_base::binary);
+	out.write(data.data(),data.size());
+}
+
+static uint64_t get(const std::string& data, size_t pos)
+{
+	uint64_t v;
+	std::memcpy(&v,data.data()+pos,sizeof(v));
+	return v;
+}
+
+static void set(std::string& data, size_t pos, uint64_t v)
+{
+	std::memcpy(&data[pos],&v,sizeof(v));
+}
+
+// gives the position of the first used slot of the file
+static size_t used_slot(const std::string& data)
+{
+	uint64_t n = get(data,NUM_SLOTS);
+	for(uint64_t i = 0; i < n; i++) {
+		size_t pos = HEADER_SIZE + i*SLOT_SIZE;
+		if(get(data,pos+SLOT_LENGTH) != 0) return pos;
+	}
+	return 0;
+}
+
+// checks that a modified file is rejected
+static int check_rejected(const std::string& filename,
+		const std::string& data, const char* what)
+{
+	write_file(filename,data);
+	dict d;
+	if(d.load(filename)) {
+		std::cout << "loaded a file with " << what << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	std::string filename = argc > 1 ? argv[1] : "test_dictionary.tmp";
+	int failures = 0;
+
+	dict saved;
+	std::vector<int> ids;
+	for(int i = 0; i < NUM_SEQ; i++)
+		ids.push_back(add(saved,i));
+	if(not saved.save(filename)) {
+		std::cout << "could not save " << filename << std::endl;
+		return 1;
+	}
+
+	dict loaded;
+	if(not loaded.load(filename)) {
+		std::cout << "could not load " << filename << std::endl;
+		return 1;
+	}
+	if(loaded.next_index() != saved.next_index()) {
+		std::cout << "next index " << loaded.next_index()
+			  << " instead of " << saved.next_index() << std::endl;
+		failures++;
+	}
+	// in another order, which would give other identifiers to new
+	// sequences
+	for(int i = NUM_SEQ-1; i >= 0; i--) {
+		if(add(loaded,i) != ids[i]) {
+			std::cout << "sequence " << i << " changed identifier"
+				  << std::endl;
+			failures++;
+		}
+	}
+	int next = loaded.next_index();
+	for(int i = NUM_SEQ; i < NUM_SEQ + 10; i++) {
+		int id = add(loaded,i);
+		if(id != next + i - NUM_SEQ) {
+			std::cout << "new sequence " << i << " got " << id
+				  << std::endl;
+			failures++;
+		}
+	}
+
+	// saving a loaded dictionary keeps both kinds of sequences
+	std::string again = filename + ".again";
+	dict reloaded;
+	if(not loaded.save(again) || not reloaded.load(again)
+	|| reloaded.next_index() != loaded.next_index()
+	|| add(reloaded,NUM_SEQ) != next
+	|| add(reloaded,0) != ids[0]) {
+		std::cout << "saving a loaded dictionary lost sequences"
+			  << std::endl;
+		failures++;
+	}
+	std::remove(again.c_str());
+
+	std::string data = read_file(filename);
+	size_t pos = used_slot(data);
+	uint64_t letters = get(data,NUM_LETTERS);
+	if(pos == 0) {
+		std::cout << "no sequence in " << filename << std::endl;
+		failures++;
+	} else {
+		std::string bad = data;
+		set(bad,pos+SLOT_OFFSET,letters);
+		failures += check_rejected(filename,bad,"an offset too large");
+		bad = data;
+		set(bad,pos+SLOT_OFFSET,letters-1);
+		set(bad,pos+SLOT_LENGTH,2);
+		failures += check_rejected(filename,bad,"a length too large");
+		bad = data;
+		set(bad,pos+SLOT_LENGTH,~(uint64_t)0);
+		failures += check_rejected(filename,bad,"a wrapping length");
+		bad = data;
+		set(bad,pos+SLOT_INDEX,saved.next_index());
+		failures += check_rejected(filename,bad,"a future identifier");
+		bad = data;
+		uint64_t n = get(data,NUM_SLOTS);
+		for(uint64_t i = 0; i < n; i++) {
+			size_t p = HEADER_SIZE + i*SLOT_SIZE;
+			if(get(bad,p+SLOT_LENGTH) == 0)
+				bad.replace(p,SLOT_SIZE,bad,pos,SLOT_SIZE);
+		}
+		failures += check_rejected(filename,bad,"no free slot");
+	}
+
+	failures += check_collisions(filename);
+
+	std::remove(filename.c_str());
+	std::cout << (failures == 0 ? "OK" : "FAILED") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
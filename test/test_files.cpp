@@ -0,0 +1,111 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <cstdlib>
+#include <mpi.h>
+#include "omniscio.h"
+#include "test_common.hpp"
+
+// Appends to two files in turn, a data file and a log, and checks that
+// the offset predicted for each write follows the previous write to the
+// same file, and that the prediction gives the handle of that file.
+// Usage: test_files [iterations]
+
+static __attribute__((noinline)) void write_data(omniscio_file f,
+				omniscio_offset offset, omniscio_size size)
+{
+	omniscio_write_start(f,offset,size);
+	omniscio_write_end(0);
+}
+
+static __attribute__((noinline)) void write_log(omniscio_file f,
+				omniscio_offset offset, omniscio_size size)
+{
+	omniscio_write_start(f,offset,size);
+	omniscio_write_end(0);
+}
+
+// checks that a prediction has the offset and the file expected
+static bool predicted(omniscio_offset offset, const omniscio_file& f)
+{
+	omniscio_req buf[4];
+	int n = 0;
+	omniscio_next_into(buf,4,0.0,&n);
+	for(int i = 0; i < n; i++) {
+		if(buf[i].offset == offset 
+		&& buf[i].fh.handle.posix == f.handle.posix) return true;
+	}
+	return false;
+}
+
+#define WARMUP 20
+
+int main(int argc, char** argv)
+{
+	long iterations = argc > 1 ? std::atol(argv[1]) : 200;
+
+	// the asynchronous consumer would learn behind the queries
+	setup_test("files");
+
+	MPI_Init(&argc,&argv);
+
+	omniscio_file data, log;
+	omniscio_file_from_posix(&data,5);
+	omniscio_file_from_posix(&log,6);
+	omniscio_open_start("data.h5",OMNISCIO_POSIX);
+	omniscio_open_end(0,data);
+	omniscio_open_start("run.log",OMNISCIO_POSIX);
+	omniscio_open_end(0,log);
+
+	long misses = 0;
+	omniscio_offset data_offset = 0, log_offset = 0;
+	for(long i = 0; i < iterations; i++) {
+		if(i > WARMUP && not predicted(data_offset,data)) misses++;
+		write_data(data,data_offset,1 << 20);
+		data_offset += 1 << 20;
+
+		// log lines of varying lengths
+		omniscio_size size = 100 + (i % 3)*20;
+		if(i > WARMUP && not predicted(log_offset,log)) misses++;
+		write_log(log,log_offset,size);
+		log_offset += size;
+	}
+
+	omniscio_close_start(data);
+	omniscio_close_end(0);
+	omniscio_close_start(log);
+	omniscio_close_end(0);
+
+	MPI_Finalize();
+
+	if(misses != 0)
+		std::cerr << misses << " offsets mispredicted" << std::endl;
+	std::cout << (misses == 0 ? "OK" : "FAILED") << std::endl;
+	return misses == 0 ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <set>
+#include <algorithm>
+#include "sequitur/oracle.hpp"
+
+using namespace omniscio::sequitur;
+
+// Feeds a periodic sequence to an oracle in freeze mode and to one that
+// always learns, and checks that the first one freezes, keeps predicting
+// what the second one predicts, and learns again after a misprediction.
+
+static const int PERIOD[] = { 1, 2, 3, 1, 2, 4, 5, 5 };
+static const int PERIOD_LENGTH = sizeof(PERIOD)/sizeof(PERIOD[0]);
+
+int main()
+{
+	int failures = 0;
+
+	oracle frozen, learning;
+	frozen.set_freeze(100,1.0);
+
+	size_t size_at_freeze = 0;
+	for(int i = 0; i < 200*PERIOD_LENGTH; i++) {
+		int x = PERIOD[i % PERIOD_LENGTH];
+		bool was_frozen = frozen.is_frozen();
+		frozen.input(x);
+		learning.input(x);
+		if(frozen.is_frozen() && not was_frozen)
+			size_at_freeze = frozen.size();
+		// a frozen grammar may lose some context, not predictions
+		std::set<int> f = frozen.predict_next();
+		std::set<int> l = learning.predict_next();
+		if(frozen.is_frozen()
+		&& not std::includes(f.begin(),f.end(),l.begin(),l.end())) {
+			std::cerr << "missing predictions after "
+				  << i << " inputs" << std::endl;
+			failures++;
+			break;
+		}
+	}
+
+	const oracle::statistics& s = frozen.get_statistics();
+	if(not frozen.is_frozen() || s.freezes != 1) {
+		std::cerr << "not frozen (" << s.freezes << " freezes)"
+			  << std::endl;
+		failures++;
+	}
+	if(s.frozen_inputs == 0 || frozen.size() != size_at_freeze) {
+		std::cerr << "the grammar kept growing: " << size_at_freeze
+			  << " then " << frozen.size() << std::endl;
+		failures++;
+	}
+	if(s.frozen_time <= 0 || s.learning_time <= 0) {
+		std::cerr << "mode times: " << s.learning_time << " "
+			  << s.frozen_time << std::endl;
+		failures++;
+	}
+
+	// an unknown symbol is mispredicted and learned
+	size_t size = frozen.size();
+	frozen.input(9);
+	if(frozen.is_frozen() || frozen.size() == size) {
+		std::cerr << "still frozen after a misprediction" << std::endl;
+		failures++;
+	}
+
+	// the predictors are not maintained in lazy mode
+	oracle lazy;
+	lazy.set_lazy(true,32);
+	lazy.set_freeze(100,1.0);
+	for(int i = 0; i < 200*PERIOD_LENGTH; i++)
+		lazy.input(PERIOD[i % PERIOD_LENGTH]);
+	if(lazy.is_frozen()) {
+		std::cerr << "frozen in lazy mode" << std::endl;
+		failures++;
+	}
+
+	std::cout << (failures == 0 ? "OK" : "FAILED") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
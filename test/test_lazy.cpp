@@ -0,0 +1,132 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <set>
+#include <algorithm>
+#include "sequitur/oracle.hpp"
+
+using namespace omniscio::sequitur;
+
+// Feeds the same sequences to an eager and to a lazy oracle and bounds
+// how far their predictions differ. The lazy oracle only replays the
+// last symbols on the current grammar, so it may predict more symbols
+// than the eager one, but it must predict at least the same ones most
+// of the time, the same ones once a periodic sequence is learned, and
+// not more than 3 times as many.
+
+static const int PERIOD[] = { 1, 2, 3, 1, 2, 4, 5, 5 };
+static const int PERIOD_LENGTH = sizeof(PERIOD)/sizeof(PERIOD[0]);
+
+#define WINDOW 32
+#define LENGTH 2000
+
+struct comparison {
+	long steps;
+	long same;	// same predictions
+	long superset;	// the lazy predictions include the eager ones
+	long eager_hits;
+	long lazy_hits;
+	long eager_size;// total number of predictions
+	long lazy_size;
+	long last_difference;
+};
+
+// the i-th symbol: the period, with noise out of 1000 symbols replaced
+// by other ones (same pseudo-random generator on every platform)
+static int symbol(long i, int noise, unsigned long& seed)
+{
+	seed = seed*1103515245 + 12345;
+	if((long)((seed >> 16) % 1000) < noise)
+		return 100 + (seed >> 8) % 5;
+	return PERIOD[i % PERIOD_LENGTH];
+}
+
+static comparison compare(int noise)
+{
+	comparison c = { 0, 0, 0, 0, 0, 0, 0, -1 };
+	oracle eager, lazy;
+	lazy.set_lazy(true,WINDOW);
+	unsigned long seed = 1;
+	for(long i = 0; i < LENGTH; i++) {
+		int x = symbol(i,noise,seed);
+		std::set<int> e = eager.predict_next();
+		std::set<int> l = lazy.predict_next();
+		c.steps++;
+		if(e == l) c.same++;
+		else c.last_difference = i;
+		if(std::includes(l.begin(),l.end(),e.begin(),e.end()))
+			c.superset++;
+		c.eager_hits += e.count(x);
+		c.lazy_hits += l.count(x);
+		c.eager_size += e.size();
+		c.lazy_size += l.size();
+		eager.input(x);
+		lazy.input(x);
+	}
+	return c;
+}
+
+int main()
+{
+	int failures = 0;
+
+	comparison p = compare(0);
+	if(p.superset != p.steps) {
+		std::cerr << "periodic: the lazy oracle missed eager "
+			  << "predictions " << p.steps - p.superset
+			  << " times" << std::endl;
+		failures++;
+	}
+	if(p.last_difference >= WINDOW + 4*PERIOD_LENGTH) {
+		std::cerr << "periodic: the predictions still differed after "
+			  << p.last_difference << " symbols" << std::endl;
+		failures++;
+	}
+
+	comparison n = compare(100);
+	if(n.superset < 0.95*n.steps) {
+		std::cerr << "noisy: the lazy predictions include the eager "
+			  << "ones " << n.superset << " times out of "
+			  << n.steps << std::endl;
+		failures++;
+	}
+	if(n.lazy_hits < n.eager_hits) {
+		std::cerr << "noisy: " << n.lazy_hits << " lazy hits, "
+			  << n.eager_hits << " eager hits" << std::endl;
+		failures++;
+	}
+	if(n.lazy_size > 3*n.eager_size) {
+		std::cerr << "noisy: " << n.lazy_size << " lazy predictions, "
+			  << n.eager_size << " eager ones" << std::endl;
+		failures++;
+	}
+
+	std::cout << (failures == 0 ? "OK" : "FAILED") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,234 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "binlog.hpp"
+#include "zlog.hpp"
+#include "logreader.hpp"
+
+using namespace omniscio;
+
+// Writes events in the binary format, in the compressed format and as
+// text lines, then checks that log_reader gives them back. A compressed
+// log that was not closed must be read up to its last complete chunk,
+// corrupt ones must only end the stream, and file names must only be
+// stored when they change.
+// Usage: test_log [file]
+
+static event make_event(int i)
+{
+	event e;
+	e.start	= 1000.0 + i*0.25;
+	e.end	= e.start + (i % 7 == 0 ? 10.0 : 0.000123456);
+	e.sym	= i % 5 + 1;
+	e.op	= i % 4;
+	e.api	= i % 3;
+	e.offset	= e.op == OMNISCIO_OPEN || e.op == OMNISCIO_CLOSE
+			? 0 : (omniscio_offset)i*4096;
+	e.size	= e.op == OMNISCIO_OPEN || e.op == OMNISCIO_CLOSE
+			? 0 : 4096;
+	e.fd	= 3 + i;
+	e.ret	= i % 6 == 0 ? -1 : 0;
+	e.name	= e.op == OMNISCIO_OPEN 
+			? (i % 8 == 0 ? "/tmp/a file" : "/tmp/x.dat") : NULL;
+	return e;
+}
+
+static bool same(const event& a, const event& b)
+{
+	return (long long)(a.start*1e9+0.5) == (long long)(b.start*1e9+0.5)
+	    && (long long)(a.end*1e9+0.5) == (long long)(b.end*1e9+0.5)
+	    && a.sym == b.sym && a.op == b.op && a.api == b.api
+	    && a.offset == b.offset && a.size == b.size
+	    && a.fd == b.fd && a.ret == b.ret
+	    && ((a.name == NULL && b.name == NULL) 
+	        || (a.name != NULL && b.name != NULL 
+		    && std::strcmp(a.name,b.name) == 0));
+}
+
+static int check(const std::string& filename, log_reader::format f, int n)
+{
+	log_reader r;
+	if(not r.open(filename) || r.get_format() != f) {
+		std::cout << filename << ": not opened as format " << f 
+			<< std::endl;
+		return 1;
+	}
+	event e;
+	int i = 0;
+	for(; r.next(e); i++) {
+		if(i >= n || not same(e,make_event(i))) {
+			std::cout << "format " << f << ": event " << i 
+				<< " differs" << std::endl;
+			return 1;
+		}
+	}
+	if(i != n) {
+		std::cout << "format " << f << ": " << i << " events out of "
+			<< n << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+// writes a compressed log made of the given chunk (event count,
+// grammar then residuals), as varints
+static void write_chunk(const std::string& filename,
+		const unsigned long long* chunk, int n)
+{
+	std::ofstream out(filename.c_str(), 
+		std::ios_base::out | std::ios_base::binary);
+	out.write("OMNIZLOG\3\0\0\0",12);
+	for(int i = 0; i < n; i++) {
+		unsigned long long v = chunk[i];
+		while(v >= 0x80) {
+			out.put((char)((v & 0x7f) | 0x80));
+			v >>= 7;
+		}
+		out.put((char)v);
+	}
+}
+
+// checks that a corrupt compressed log gives at most max events
+static int check_corrupt(const std::string& filename, const char* what,
+		const unsigned long long* chunk, int n, int max)
+{
+	write_chunk(filename,chunk,n);
+	log_reader r;
+	event e;
+	int i = 0;
+	if(r.open(filename)) while(i <= max && r.next(e)) i++;
+	if(i > max) {
+		std::cout << what << ": " << i << " events read" << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	static const char* ops[4] = {"OPEN","CLOSE","READ","WRITE"};
+	static const char* apis[3] = {"POSIX","MPIIO","LIBC"};
+	std::string filename = argc > 1 ? argv[1] : "test_log.tmp";
+	int n = 100;
+	int failures = 0;
+
+	std::ofstream out(filename.c_str(), 
+		std::ios_base::out | std::ios_base::binary);
+	binlog_writer w;
+	w.open(out);
+	for(int i = 0; i < n; i++) w.write(make_event(i));
+	w.close();
+	out.close();
+	failures += check(filename,log_reader::BINARY,n);
+
+	// offsets, sizes and durations are in turn predicted and not
+	// (residuals), in several chunks
+	out.open(filename.c_str(), 
+		std::ios_base::out | std::ios_base::binary);
+	zlog_encoder z;
+	z.open(out,16);
+	for(int i = 0; i < n; i++) z.encode(make_event(i));
+	z.close();
+	out.close();
+	failures += check(filename,log_reader::COMPRESSED,n);
+
+	// a call site that always opens the same file stores its name once
+	std::string path(100,'x');
+	out.open(filename.c_str(), 
+		std::ios_base::out | std::ios_base::binary);
+	zlog_encoder opens;
+	opens.open(out);
+	for(int i = 0; i < 1000; i++) {
+		event e = make_event(0);
+		e.start = e.end = i;
+		e.name = path.c_str();
+		opens.encode(e);
+	}
+	opens.close();
+	out.close();
+	std::ifstream in(filename.c_str());
+	in.seekg(0,std::ios::end);
+	if(in.tellg() > 10*1000) {
+		std::cout << "1000 opens of the same file take " << in.tellg()
+			  << " bytes" << std::endl;
+		failures++;
+	}
+	in.close();
+
+	// as left by a process that did not finalize
+	out.open(filename.c_str(), 
+		std::ios_base::out | std::ios_base::binary);
+	zlog_encoder crashed;
+	crashed.open(out,16);
+	for(int i = 0; i < n; i++) crashed.encode(make_event(i));
+	out.close();
+	failures += check(filename,log_reader::COMPRESSED,n - n%16);
+
+	// symbols are 2*terminal+1 or 2*rule, a name follows its length
+	const unsigned long long huge = 1ULL << 62;
+	const unsigned long long self[] = { 4, 1, 2, 0, 3 };
+	failures += check_corrupt(filename,"rule containing itself",
+				  self,sizeof(self)/sizeof(self[0]),1);
+	const unsigned long long loop[] = { 4, 3, 1, 2, 1, 4, 1, 2 };
+	failures += check_corrupt(filename,"rules containing each other",
+				  loop,sizeof(loop)/sizeof(loop[0]),0);
+	const unsigned long long rules[] = { huge, huge, 1, 3 };
+	failures += check_corrupt(filename,"too many rules",
+				  rules,sizeof(rules)/sizeof(rules[0]),0);
+	const unsigned long long length[] = { 1, 1, huge, 3 };
+	failures += check_corrupt(filename,"rule too long",
+				  length,sizeof(length)/sizeof(length[0]),0);
+	const unsigned long long name[] = { 1, 1, 1, 3, 0x40, huge };
+	failures += check_corrupt(filename,"name too long",
+				  name,sizeof(name)/sizeof(name[0]),0);
+
+	// same layout as log_event in omniscio.cpp
+	out.open(filename.c_str());
+	out << std::fixed << std::setprecision(9);
+	for(int i = 0; i < n; i++) {
+		event e = make_event(i);
+		out << e.start << ' ' << e.sym << ' '
+		    << ops[e.op] << ' ' << apis[e.api];
+		if(e.op == OMNISCIO_OPEN) out << " _ " << e.name;
+		else if(e.op == OMNISCIO_CLOSE) out << " _ _";
+		else out << ' ' << e.offset << ' ' << e.size;
+		out << ' ' << e.fd << ' ' << e.ret << ' ' << e.end << '\n';
+	}
+	out.close();
+	failures += check(filename,log_reader::TEXT,n);
+
+	std::remove(filename.c_str());
+	std::cout << (failures == 0 ? "OK" : "FAILED") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
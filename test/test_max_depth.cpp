@@ -0,0 +1,140 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <cstdlib>
+#include "sequitur/oracle.hpp"
+
+using namespace omniscio::sequitur;
+
+// Feeds a long periodic sequence to oracles whose depth is bounded
+// (set_max_depth) and checks, from the exported rules, that no rule
+// but the start rule goes deeper than the bound, and that the next
+// symbol is still predicted. Without the bound, the same sequence
+// gives deeper rules.
+// Usage: test_max_depth [periods]
+
+static const int PERIOD[] = { 1, 2, 3, 1, 2, 4, 5, 5, 6, 1, 2, 3 };
+static const int PERIOD_LENGTH = sizeof(PERIOD)/sizeof(PERIOD[0]);
+
+// depth of the rule r of the exported grammar: 1 for a rule made of
+// terminals, 1 + the depth of its deepest rule otherwise
+static int depth(const std::vector<std::vector<ulong> >& rules, size_t r,
+		std::vector<int>& known)
+{
+	if(known[r] != 0) return known[r];
+	int d = 0;
+	for(size_t i = 0; i < rules[r].size(); i++) {
+		ulong s = rules[r][i];
+		if(s % 2 == 1) continue;
+		int c = depth(rules,s/2,known);
+		if(c > d) d = c;
+	}
+	known[r] = d + 1;
+	return known[r];
+}
+
+// gives the depth of the deepest rule other than the start rule
+static int max_rule_depth(const oracle& o)
+{
+	std::vector<std::vector<ulong> > rules;
+	o.export_rules(rules);
+	std::vector<int> known(rules.size(),0);
+	int result = 0;
+	for(size_t r = 1; r < rules.size(); r++) {
+		int d = depth(rules,r,known);
+		if(d > result) result = d;
+	}
+	return result;
+}
+
+// feeds the sequence, gives the number of mispredictions after the
+// first periods and the deepest rule seen along the way
+static long run(oracle& o, long periods, int& deepest)
+{
+	long misses = 0;
+	deepest = 0;
+	for(long i = 0; i < periods*PERIOD_LENGTH; i++) {
+		int x = PERIOD[i % PERIOD_LENGTH];
+		if(i >= 4*PERIOD_LENGTH) {
+			std::set<int> p = o.predict_next();
+			if(p.find(x) == p.end()) misses++;
+		}
+		o.input(x);
+		if(i % 97 == 0) {
+			int d = max_rule_depth(o);
+			if(d > deepest) deepest = d;
+		}
+	}
+	int d = max_rule_depth(o);
+	if(d > deepest) deepest = d;
+	return misses;
+}
+
+int main(int argc, char** argv)
+{
+	long periods = argc > 1 ? std::atol(argv[1]) : 1000;
+	int failures = 0;
+
+	oracle unbounded;
+	int unbounded_depth;
+	run(unbounded,periods,unbounded_depth);
+
+	for(int bound = 1; bound <= 4; bound++) {
+		oracle o;
+		o.set_max_depth(bound);
+		int deepest;
+		long misses = run(o,periods,deepest);
+		if(deepest > bound) {
+			std::cerr << "bound " << bound << ": rule of depth "
+				  << deepest << std::endl;
+			failures++;
+		}
+		if(misses != 0) {
+			std::cerr << "bound " << bound << ": " << misses
+				  << " mispredictions" << std::endl;
+			failures++;
+		}
+		if(unbounded_depth > bound
+		&& o.get_statistics().refusals == 0) {
+			std::cerr << "bound " << bound << ": no match refused"
+				  << std::endl;
+			failures++;
+		}
+	}
+	if(unbounded_depth <= 1) {
+		std::cerr << "the sequence only gives rules of depth "
+			  << unbounded_depth << std::endl;
+		failures++;
+	}
+
+	std::cout << (failures == 0 ? "OK" : "FAILED") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
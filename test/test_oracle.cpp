@@ -0,0 +1,115 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <cstdlib>
+#include "sequitur/oracle.hpp"
+
+using namespace omniscio::sequitur;
+
+// Feeds the same sequence to two oracles, allocating and freeing memory
+// between their inputs so that their symbols lie at unrelated addresses,
+// and checks that they always predict the same symbols. The predictions
+// used to depend on the heap: a symbol deleted by check() was matched
+// against the predictors, and a symbol promoted to a predictor through
+// one parent could be reset through another one.
+// Usage: test_oracle [length] [sequences]
+
+// gives a sequence made of repeated patterns, some of them with
+// variants, in a random order
+static std::vector<int> make_sequence(long length, unsigned seed)
+{
+	std::vector<int> seq;
+	srand(seed);
+	while((long)seq.size() < length) {
+		int pattern = rand() % 4;
+		int repeats = 1 + rand() % 5;
+		for(int r = 0; r < repeats; r++) {
+			switch(pattern) {
+			case 0:
+				seq.push_back(1);
+				seq.push_back(2);
+				seq.push_back(3);
+				break;
+			case 1:
+				seq.push_back(1);
+				seq.push_back(2);
+				seq.push_back(4);
+				seq.push_back(4);
+				break;
+			case 2:
+				seq.push_back(5);
+				seq.push_back(rand() % 3 ? 6 : 7);
+				break;
+			default:
+				seq.push_back(8 + rand() % 3);
+			}
+		}
+	}
+	return seq;
+}
+
+int main(int argc, char** argv)
+{
+	long length = argc > 1 ? std::atol(argv[1]) : 1000;
+	int sequences = argc > 2 ? std::atoi(argv[2]) : 10;
+	int failures = 0;
+
+	for(int n = 1; n <= sequences; n++) {
+		std::vector<int> seq = make_sequence(length,n);
+		oracle* a = new oracle();
+		oracle* b = new oracle();
+		std::vector<char*> blocks;
+		for(size_t i = 0; i < seq.size(); i++) {
+			a->input(seq[i]);
+			for(size_t j = 0; j < i % 7; j++)
+				blocks.push_back(new char[16 + (i*j) % 200]);
+			for(size_t j = 0; i % 3 == 0 && j < blocks.size(); j += 2) {
+				delete[] blocks[j];
+				blocks[j] = new char[8];
+			}
+			b->input(seq[i]);
+			if(a->predict_next() != b->predict_next()) {
+				std::cerr << "sequence " << n << ": different "
+					  << "predictions after " << i+1
+					  << " inputs" << std::endl;
+				failures++;
+				break;
+			}
+		}
+		delete a;
+		delete b;
+		for(size_t j = 0; j < blocks.size(); j++)
+			delete[] blocks[j];
+	}
+
+	std::cout << (failures == 0 ? "OK" : "FAILED") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <cstdlib>
+#include <ctime>
+#include <mpi.h>
+#include "omniscio.h"
+#include "test_common.hpp"
+
+// Traces small writes back to back with a budget of 1% of the time in
+// Omnisc'IO until the learning is paused, then, after a long idle
+// period, writes far apart (each taking well below 1% of the time
+// between them) until the controller is back to full learning, after
+// which every write must be learned. The phases end on the state of the
+// controller, not after a given time, so that a slow or loaded machine
+// only makes them longer.
+// Usage: test_overhead
+
+__attribute__((noinline)) static void traced_write(omniscio_file f,
+				omniscio_offset offset, omniscio_size size)
+{
+	omniscio_write_start(f,offset,size);
+	omniscio_write_end(0);
+}
+
+static void sleep_ms(long ms)
+{
+	struct timespec pause = { ms/1000, (ms%1000)*1000000 };
+	nanosleep(&pause,NULL);
+}
+
+#define LEVEL_PAUSED	6
+#define BURST_MAX	30.0	// s
+#define IDLE_MS		1000
+#define SPACING_MS	200
+#define SPACED_MAX	100
+#define FINAL		10
+
+int main(int argc, char** argv)
+{
+	// the operations are learned by the calling thread
+	setup_test("overhead");
+	setenv("OMNISCIO_MAX_OVERHEAD","1%",1);
+
+	MPI_Init(&argc,&argv);
+
+	omniscio_file f;
+	omniscio_file_from_posix(&f,3);
+
+	int failures = 0;
+	long i = 0;
+	omniscio_stats s;
+	double start = MPI_Wtime();
+	do {
+		for(int k = 0; k < 100; k++, i++) traced_write(f,i*64,64);
+		omniscio_get_stats(&s);
+	} while(s.overhead_current < LEVEL_PAUSED 
+		&& MPI_Wtime() - start < BURST_MAX);
+	if(s.overhead_current != LEVEL_PAUSED || s.overhead_skipped == 0
+	|| s.inputs + s.overhead_skipped != i) {
+		std::cerr << "burst of " << i << " writes: level " 
+			  << s.overhead_current << ", " << s.inputs
+			  << " learned, " << s.overhead_skipped 
+			  << " skipped" << std::endl;
+		failures++;
+	}
+
+	// each write after a pause brings the level down by one
+	sleep_ms(IDLE_MS);
+	int spaced = 0;
+	do {
+		traced_write(f,i*64,64);
+		i++;
+		sleep_ms(SPACING_MS);
+		omniscio_get_stats(&s);
+	} while(s.overhead_current > 0 && ++spaced < SPACED_MAX);
+	if(s.overhead_current != 0) {
+		std::cerr << "still at level " << s.overhead_current 
+			  << " after " << spaced << " spaced writes" << std::endl;
+		failures++;
+	}
+
+	omniscio_get_stats(&s);
+	long learned = s.inputs;
+	for(int k = 0; k < FINAL; k++, i++) traced_write(f,i*64,64);
+	omniscio_get_stats(&s);
+	if(s.inputs - learned != FINAL) {
+		std::cerr << s.inputs - learned << " of the last " << FINAL
+			  << " writes learned" << std::endl;
+		failures++;
+	}
+
+	MPI_Finalize();
+
+	std::cout << (failures == 0 ? "OK" : "FAILED") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
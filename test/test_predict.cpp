@@ -0,0 +1,162 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <mpi.h>
+#include "omniscio.h"
+#include "test_common.hpp"
+
+// Traces a repeated pattern of writes and checks, after each of them,
+// that omniscio_next_into gives the same predictions as omniscio_next
+// without allocating any memory, and that it honors its capacity and
+// threshold.
+// Usage: test_predict [iterations]
+
+extern "C" {
+	void* __libc_malloc(size_t);
+	void* __libc_calloc(size_t, size_t);
+	void* __libc_realloc(void*, size_t);
+}
+
+// allocations of the main thread only, the writer may allocate
+static __thread long _allocations_ = 0;
+
+extern "C" void* malloc(size_t size)
+{
+	_allocations_++;
+	return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size)
+{
+	_allocations_++;
+	return __libc_calloc(n,size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+	_allocations_++;
+	return __libc_realloc(ptr,size);
+}
+
+template<int K>
+__attribute__((noinline)) static void traced_write(omniscio_file f,
+					omniscio_offset offset, omniscio_size size)
+{
+	omniscio_write_start(f,offset,size*(K+1));
+	omniscio_write_end(0);
+}
+
+static bool same(const omniscio_req& a, const omniscio_req& b)
+{
+	return a.type == b.type && a.offset == b.offset && a.size == b.size
+		&& a.date == b.date && a.proba == b.proba;
+}
+
+#define CAPACITY 16
+
+int main(int argc, char** argv)
+{
+	long iterations = argc > 1 ? std::atol(argv[1]) : 200;
+
+	setup_test("predict");
+
+	MPI_Init(&argc,&argv);
+
+	omniscio_file f;
+	omniscio_file_from_posix(&f,3);
+
+	int failures = 0;
+	long allocations = 0;
+	long predicted = 0;
+	omniscio_req buf[CAPACITY];
+	for(long i = 0; i < iterations; i++) {
+		// the second call site alternates between two sizes and
+		// is followed by either of the others
+		traced_write<0>(f,i*4096,4096);
+		traced_write<1>(f,i*4096,i % 2 ? 512 : 1024);
+		if(i % 3 == 0) traced_write<2>(f,0,64);
+		else traced_write<3>(f,0,64);
+
+		long before = _allocations_;
+		int n = -1;
+		if(omniscio_next_into(buf,CAPACITY,0.0,&n) != OMNISCIO_OK) {
+			std::cerr << "omniscio_next_into failed" << std::endl;
+			failures++;
+			break;
+		}
+		allocations += _allocations_ - before;
+		predicted += n;
+
+		omniscio_req* p;
+		int m;
+		omniscio_next(&p,&m);
+		bool equal = (m == n);
+		for(int j = 0; equal && j < n; j++) {
+			equal = false;
+			for(int k = 0; k < m && not equal; k++)
+				equal = same(buf[j],p[k]);
+		}
+		for(int j = 1; j < n; j++)
+			if(buf[j].proba > buf[j-1].proba) equal = false;
+		omniscio_free(p);
+		if(not equal) {
+			std::cerr << "different predictions after " << i 
+				  << " iterations" << std::endl;
+			failures++;
+			break;
+		}
+
+		// top-1 and a threshold above every probability
+		int one = -1, none = -1;
+		omniscio_next_into(buf,1,0.0,&one);
+		omniscio_next_into(buf,CAPACITY,1.5,&none);
+		if(one != (n > 0 ? 1 : 0) || none != 0) {
+			std::cerr << "capacity or threshold ignored: " << one
+				  << " and " << none << " predictions" << std::endl;
+			failures++;
+			break;
+		}
+	}
+
+	if(allocations != 0) {
+		std::cerr << allocations << " allocations" << std::endl;
+		failures++;
+	}
+	if(predicted == 0) {
+		std::cerr << "no prediction" << std::endl;
+		failures++;
+	}
+
+	MPI_Finalize();
+
+	std::cout << (failures == 0 ? "OK" : "FAILED") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
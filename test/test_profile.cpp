@@ -0,0 +1,136 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <glob.h>
+#include <mpi.h>
+#include "omniscio.h"
+#include "test_common.hpp"
+#include "stats/histogram.hpp"
+
+// Checks the percentiles of the histograms against a known
+// distribution, then traces writes with OMNISCIO_PROFILE set and checks
+// that each stage was measured for each of them and written in the
+// .profile file.
+// Usage: test_profile [iterations]
+
+using namespace omniscio;
+
+static int check_histogram()
+{
+	int failures = 0;
+	histogram h;
+	if(h.percentile(50.0) != 0) failures++;
+	for(long long x = 1; x <= 100000; x++) h.add(x);
+	double p[4] = { 1.0, 50.0, 90.0, 99.0 };
+	for(int i = 0; i < 4; i++) {
+		double expected = p[i]*1000.0;
+		double error = std::fabs(h.percentile(p[i]) - expected)/expected;
+		if(error > 1.0/HISTOGRAM_SUB) {
+			std::cerr << "percentile " << p[i] << ": " 
+				  << h.percentile(p[i]) << std::endl;
+			failures++;
+		}
+	}
+	if(h.percentile(100.0) != 100000 || h.get_count() != 100000
+	|| h.get_total() != 100000LL*100001/2) failures++;
+	// small values are exact, large ones do not overflow
+	histogram g;
+	for(int i = 0; i < 10; i++) g.add(3);
+	g.add(1LL << 62);
+	if(g.percentile(50.0) != 3 || g.percentile(100.0) != 1LL << 62)
+		failures++;
+	g += h;
+	if(g.get_count() != 100011) failures++;
+	return failures;
+}
+
+__attribute__((noinline)) static void traced_write(omniscio_file f,
+				omniscio_offset offset, omniscio_size size)
+{
+	omniscio_write_start(f,offset,size);
+	omniscio_write_end(0);
+}
+
+int main(int argc, char** argv)
+{
+	long iterations = argc > 1 ? std::atol(argv[1]) : 500;
+	int failures = check_histogram();
+
+	std::string dir = setup_test("profile");
+	setenv("OMNISCIO_PROFILE","1",1);
+
+	MPI_Init(&argc,&argv);
+
+	omniscio_file f;
+	omniscio_file_from_posix(&f,3);
+	for(long i = 0; i < iterations; i++) traced_write(f,i*512,512);
+
+	// the operations are all learned once finalized
+	MPI_Finalize();
+
+	for(int s = OMNISCIO_STAGE_UNWIND; s <= OMNISCIO_STAGE_TOTAL; s++) {
+		omniscio_profile p;
+		omniscio_stage stage = (omniscio_stage)s;
+		if(omniscio_get_profile(OMNISCIO_WRITE,stage,&p) != OMNISCIO_OK) {
+			failures++;
+			continue;
+		}
+		// the call site cache skips the dictionary
+		bool counted = s == OMNISCIO_STAGE_DICTIONARY ?
+			p.count > 0 && p.count < iterations : p.count == iterations;
+		long long p90 = -1;
+		omniscio_get_percentile(OMNISCIO_WRITE,stage,90.0,&p90);
+		if(not counted || p.p50 > p90 || p90 > p.p99 || p.p99 > p.max
+		|| p.total < p.p50*(p.count/2)) {
+			std::cerr << "stage " << s << ": " << p.count << " "
+				  << p.total << " " << p.p50 << " " << p90 
+				  << " " << p.p99 << " " << p.max << std::endl;
+			failures++;
+		}
+	}
+
+	omniscio_profile p;
+	if(omniscio_get_profile(OMNISCIO_READ,OMNISCIO_STAGE_TOTAL,&p) 
+		!= OMNISCIO_OK || p.count != 0) failures++;
+	if(omniscio_get_profile(OMNISCIO_WRITE,(omniscio_stage)42,&p) 
+		!= OMNISCIO_ERROR) failures++;
+
+	std::string pattern = dir + "/*.profile";
+	glob_t g;
+	if(glob(pattern.c_str(),0,NULL,&g) != 0 || g.gl_pathc != 1) {
+		std::cerr << "no profile written" << std::endl;
+		failures++;
+	}
+	globfree(&g);
+
+	std::cout << (failures == 0 ? "OK" : "FAILED") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
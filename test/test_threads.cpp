@@ -0,0 +1,134 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+#include <mpi.h>
+#include "omniscio.h"
+#include "test_common.hpp"
+
+// Traces writes from several threads at once, each from its own call
+// sites, and checks that no operation fails and that every operation
+// reaches the model (or is counted as dropped in asynchronous mode).
+// The threads are started again for each round, the states of those
+// that exited must be freed without losing their operations.
+// Usage: test_threads [threads] [iterations] [async] [rounds]
+
+static long _iterations_ = 2000;
+static long _failures_ = 0;
+
+template<int K>
+__attribute__((noinline)) static int traced_write(int fd, long i)
+{
+	omniscio_file f;
+	omniscio_file_from_posix(&f,fd);
+	if(omniscio_write_start(f,i*(K+1)*512,(K+1)*512) != OMNISCIO_OK)
+		return OMNISCIO_ERROR;
+	return omniscio_write_end(0);
+}
+
+typedef int (*write_fn)(int,long);
+
+static write_fn _writes_[] = {
+	traced_write<0>, traced_write<1>, traced_write<2>, traced_write<3>,
+	traced_write<4>, traced_write<5>, traced_write<6>, traced_write<7>
+};
+
+static const int NUM_WRITES = sizeof(_writes_)/sizeof(_writes_[0]);
+
+static void* run(void* arg)
+{
+	long t = (long)arg;
+	for(long i = 0; i < _iterations_; i++) {
+		// two call sites per thread, alternating
+		write_fn w = _writes_[(2*t+(i&1)) % NUM_WRITES];
+		if(w(3+t,i) != OMNISCIO_OK)
+			__sync_fetch_and_add(&_failures_,1);
+	}
+	return NULL;
+}
+
+int main(int argc, char** argv)
+{
+	setup_test("threads");
+	int threads = 4;
+	if(argc > 1) threads = std::atoi(argv[1]);
+	if(argc > 2) _iterations_ = std::atol(argv[2]);
+	if(argc > 3 && std::strcmp(argv[3],"async") == 0)
+		setenv("OMNISCIO_ASYNC","65536",1);
+	int rounds = argc > 4 ? std::atoi(argv[4]) : 3;
+
+	MPI_Init(&argc,&argv);
+
+	std::vector<pthread_t> ids(threads);
+	for(int r = 0; r < rounds; r++) {
+		for(int t = 0; t < threads; t++)
+			pthread_create(&ids[t],NULL,run,(void*)(long)t);
+		for(int t = 0; t < threads; t++)
+			pthread_join(ids[t],NULL);
+	}
+
+	long total = rounds*threads*_iterations_;
+	omniscio_stats s;
+	// in asynchronous mode the model catches up in the background
+	for(int tries = 0; tries < 1000; tries++) {
+		omniscio_get_stats(&s);
+		if(s.inputs + s.async_drops >= total) break;
+		usleep(10000);
+	}
+
+	int failures = 0;
+	if(_failures_ != 0) {
+		std::cerr << _failures_ << " operations failed" << std::endl;
+		failures++;
+	}
+	if(s.inputs + s.async_drops != total) {
+		std::cerr << s.inputs << " inputs and " << s.async_drops
+			  << " drops for " << total << " operations" << std::endl;
+		failures++;
+	}
+	if(s.threads != 0) {
+		std::cerr << s.threads << " states of exited threads" << std::endl;
+		failures++;
+	}
+	if(s.callsite_hits + s.callsite_misses != total) {
+		std::cerr << s.callsite_hits << " hits and "
+			  << s.callsite_misses << " misses for " << total
+			  << " operations" << std::endl;
+		failures++;
+	}
+
+	MPI_Finalize();
+
+	std::cout << (failures == 0 ? "OK" : "FAILED") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
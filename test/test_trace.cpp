@@ -0,0 +1,172 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <cstdlib>
+#include <signal.h>
+#include "trace.hpp"
+#include "dictionary.hpp"
+
+using namespace omniscio;
+
+// Checks that capturing a known call stack, normalizing its frames and
+// looking it up in the dictionary does not allocate any memory, with each unwinder and
+// from a signal handler, and that each unwinder fills the buffer it is given.
+// Usage: test_trace [iterations]
+
+extern "C" {
+	int omniscio_tracing_enabled = 0;
+	__thread int omniscio_untraced = 0;
+
+	void* __libc_malloc(size_t);
+	void* __libc_calloc(size_t, size_t);
+	void* __libc_realloc(void*, size_t);
+}
+
+static long _allocations_ = 0;
+
+extern "C" void* malloc(size_t size)
+{
+	__sync_fetch_and_add(&_allocations_,1);
+	return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size)
+{
+	__sync_fetch_and_add(&_allocations_,1);
+	return __libc_calloc(n,size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+	__sync_fetch_and_add(&_allocations_,1);
+	return __libc_realloc(ptr,size);
+}
+
+static dictionary<omniscio_addr,int> _dictionary_;
+
+static int __attribute__((noinline)) capture()
+{
+	trace t(OMNISCIO_MAX_FRAMES);
+	if(t.empty()) return 0;
+	t.normalize();
+	return _dictionary_.insert(t.begin(),t.end());
+}
+
+// three call sites, hence three different stacks
+static int __attribute__((noinline)) site(int i)
+{
+	int r = 0;
+	switch(i) {
+	case 0: r = capture(); break;
+	case 1: r = capture(); break;
+	default: r = capture(); break;
+	}
+	__asm__ __volatile__("" ::: "memory");
+	return r;
+}
+
+#define FEW_FRAMES 4
+
+// unwinds with room for FEW_FRAMES frames from deeper in the stack
+static size_t __attribute__((noinline)) few_frames(int depth)
+{
+	void* buffer[FEW_FRAMES];
+	size_t n = depth > 0 ? few_frames(depth-1) : unwind(buffer,FEW_FRAMES);
+	__asm__ __volatile__("" ::: "memory");
+	return n;
+}
+
+static volatile size_t _handler_frames_ = 0;
+
+static void handler(int)
+{
+	trace t(OMNISCIO_MAX_FRAMES);
+	_handler_frames_ = t.size();
+}
+
+int main(int argc, char** argv)
+{
+	long iterations = argc > 1 ? std::atol(argv[1]) : 10000;
+	int failures = 0;
+
+	open_modules("/dev/null");
+
+	const char* names[] = { "glibc", "fp", "libunwind" };
+	for(int u = 0; u < 3; u++) {
+		unwinder uw = find_unwinder(names[u]);
+		if(uw == NULL) continue;
+		unwind = uw;
+
+		// the first pass lets the dictionary learn the stacks, the
+		// second one only captures known stacks
+		int sym[3] = { 0, 0, 0 };
+		bool consistent = true;
+		long allocations = 0;
+		for(int pass = 0; pass < 2; pass++) {
+			long before = _allocations_;
+			long count = (pass == 0) ? 3 : iterations;
+			for(long n = 0; n < count; n++) {
+				int i = n % 3;
+				int s = site(i);
+				if(pass == 0) sym[i] = s;
+				consistent = consistent && (s == sym[i]);
+			}
+			allocations = _allocations_ - before;
+		}
+
+		std::cout << names[u] << ": " << allocations 
+			  << " allocations for " << iterations
+			  << " captures" << std::endl;
+		if(allocations != 0 || not consistent) failures += 1;
+		if(not consistent) {
+			std::cout << names[u] << ": inconsistent symbols"
+				  << std::endl;
+		}
+		// every unwinder fills the buffer when the stack is deeper
+		size_t n = few_frames(2*FEW_FRAMES);
+		if(n != FEW_FRAMES) {
+			std::cout << names[u] << ": " << n << " frames out of "
+				  << FEW_FRAMES << std::endl;
+			failures += 1;
+		}
+	}
+
+	unwind = find_unwinder("fp");
+	signal(SIGUSR1,handler);
+	raise(SIGUSR1);
+	long before = _allocations_;
+	raise(SIGUSR1);
+	long allocations = _allocations_ - before;
+	std::cout << "signal handler: " << allocations << " allocations, "
+		  << _handler_frames_ << " frames" << std::endl;
+	if(allocations != 0 || _handler_frames_ == 0) failures += 1;
+
+	std::cout << (failures == 0 ? "OK" : "FAILED") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
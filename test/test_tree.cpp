@@ -26,6 +26,10 @@
 *******************************************************************************/
 
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <time.h>
 #include "tree.hpp"
 
 using namespace omniscio;
@@ -44,6 +48,66 @@ void print_tree(const tree<char>::iterator& t) {
 	}
 }
 
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// Builds a tree from random paths of the given depth, in which each
+// node has up to width children, then measures the time to walk down
+// all the paths with find_child and with a linear search of the
+// siblings (what the dictionary used to do).
+static bool bench(size_t width, size_t depth, size_t paths, int rounds)
+{
+	tree<long> t;
+	tree<long>::iterator root = t.add_root(0);
+	std::vector<std::vector<long> > p(paths,std::vector<long>(depth));
+	for(size_t i = 0; i < paths; i++) {
+		tree<long>::iterator n = root;
+		for(size_t d = 0; d < depth; d++) {
+			// letters look like return addresses
+			long l = 0x400000 + 16*(std::rand() % width);
+			p[i][d] = l;
+			tree<long>::iterator c = n.find_child(l);
+			if(c == n.end()) c = n.append_child(l);
+			n = c;
+		}
+	}
+
+	bool ok = true;
+	size_t found = 0;
+	double start = now();
+	for(int r = 0; r < rounds; r++) {
+		for(size_t i = 0; i < paths; i++) {
+			tree<long>::iterator n = root;
+			for(size_t d = 0; d < depth && n != t.end(); d++)
+				n = n.find_child(p[i][d]);
+			found += (n != t.end());
+		}
+	}
+	double indexed = (now() - start)*1e9/(rounds*paths*depth);
+
+	start = now();
+	for(int r = 0; r < rounds; r++) {
+		for(size_t i = 0; i < paths; i++) {
+			tree<long>::iterator n = root;
+			for(size_t d = 0; d < depth && n != t.end(); d++)
+				n = std::find(n.begin(),n.end(),p[i][d]);
+			found -= (n != t.end());
+		}
+	}
+	double linear = (now() - start)*1e9/(rounds*paths*depth);
+	ok = (found == 0);
+
+	std::cout << "width " << width << ", depth " << depth
+		  << ": find_child " << indexed << " ns/level, "
+		  << "linear " << linear << " ns/level"
+		  << (ok ? "" : " MISMATCH") << std::endl;
+	return ok;
+}
+
 int main(int argc, char** argv) {
 
 	tree<char> t;
@@ -63,6 +127,21 @@ int main(int argc, char** argv) {
 	a.append_child('E');
 
 	print_tree(a);
+	std::cout << std::endl;
+
+	std::cout << "find E = " << *(a.find_child('E')) << ", "
+		  << "find Z is end = " << (a.find_child('Z') == a.end())
+		  << std::endl;
+
+	// benchmark, test_tree [depth] [paths] [rounds]
+	size_t depth = argc > 1 ? std::atoi(argv[1]) : 16;
+	size_t paths = argc > 2 ? std::atoi(argv[2]) : 4096;
+	int rounds = argc > 3 ? std::atoi(argv[3]) : 20;
+	size_t widths[] = { 2, 8, 32, 128, 1024 };
+	bool ok = true;
+	for(size_t i = 0; i < sizeof(widths)/sizeof(size_t); i++) {
+		ok = bench(widths[i],depth,paths,rounds) && ok;
+	}
 
-	return 0;
+	return ok ? 0 : 1;
 }
@@ -0,0 +1,195 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <dirent.h>
+#include <mpi.h>
+#include "omniscio.h"
+#include "test_common.hpp"
+#include "logreader.hpp"
+
+using namespace omniscio;
+
+// Writes in turn from two call sites, each to its own file. Rank 0
+// starts with the first site, the other ranks with the second one, so
+// that the two sites get different local symbols on rank 0 and on the
+// others. Only the frame of the call site is kept (OMNISCIO_STACK_DEPTH
+// =1), so that the writes issued after omniscio_unify come from the
+// same call stacks as before. The predictions must not change across
+// the call (the model, the tables and the state of the files are
+// renamed together), the writes that follow must still be predicted,
+// and their symbols in the logs must be the same on all the ranks.
+// To be run on at least 2 ranks (mpirun -np 2 test_unify).
+// Usage: test_unify [iterations]
+
+__attribute__((noinline)) static void site_a(omniscio_file f, long i)
+{
+	omniscio_write_start(f,i*100,100);
+	omniscio_write_end(0);
+}
+
+__attribute__((noinline)) static void site_b(omniscio_file f, long i)
+{
+	omniscio_write_start(f,i*200,200);
+	omniscio_write_end(0);
+}
+
+#define NUM_PRED 4
+
+static int predict(omniscio_req* buf)
+{
+	int n = 0;
+	omniscio_next_into(buf,NUM_PRED,0.0,&n);
+	return n;
+}
+
+// gives the path of the log written in the given directory
+static std::string find_log(const std::string& dir)
+{
+	std::string found;
+	DIR* d = opendir(dir.c_str());
+	if(d == NULL) return found;
+	struct dirent* e;
+	while((e = readdir(d)) != NULL) {
+		std::string name(e->d_name);
+		if(name.size() > 3 && name.substr(name.size()-3) == "log")
+			found = dir + "/" + name;
+	}
+	closedir(d);
+	return found;
+}
+
+#define WARMUP 10
+
+int main(int argc, char** argv)
+{
+	long iterations = argc > 1 ? std::atol(argv[1]) : 30;
+
+	// one directory per rank, so that each rank finds its own log
+	std::string dir = setup_test("unify",true);
+	if(dir.empty()) {
+		std::cout << "FAILED" << std::endl;
+		return 1;
+	}
+	setenv("OMNISCIO_STACK_DEPTH","1",1);
+	setenv("OMNISCIO_CALLSITE_CACHE","0",1);
+	unsetenv("OMNISCIO_UNIFY");
+	unsetenv("OMNISCIO_LOG_FORMAT");
+
+	MPI_Init(&argc,&argv);
+	int rank, size;
+	MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+	MPI_Comm_size(MPI_COMM_WORLD,&size);
+
+	omniscio_file a, b;
+	omniscio_file_from_posix(&a,5);
+	omniscio_file_from_posix(&b,6);
+	omniscio_open_start("a.dat",OMNISCIO_POSIX);
+	omniscio_open_end(0,a);
+	omniscio_open_start("b.dat",OMNISCIO_POSIX);
+	omniscio_open_end(0,b);
+
+	long errors = 0;
+	long i = 0;
+	if(rank != 0) site_b(b,i++);
+	for(; i < iterations; i++) {
+		site_a(a,i);
+		site_b(b,i);
+	}
+	long before = 2 + 2*iterations - (rank != 0 ? 1 : 0);
+
+	omniscio_req old_pred[NUM_PRED], new_pred[NUM_PRED];
+	int old_n = predict(old_pred);
+	if(omniscio_unify() != OMNISCIO_OK) errors++;
+	int new_n = predict(new_pred);
+
+	if(old_n != new_n || old_n == 0) errors++;
+	for(int k = 0; k < old_n && k < new_n; k++) {
+		if(old_pred[k].type != new_pred[k].type
+		|| old_pred[k].fh.handle.posix != new_pred[k].fh.handle.posix
+		|| old_pred[k].offset != new_pred[k].offset
+		|| old_pred[k].size != new_pred[k].size
+		|| old_pred[k].proba != new_pred[k].proba)
+			errors++;
+	}
+	if(errors != 0)
+		std::cerr << "[" << rank << "] predictions changed by unify"
+			  << std::endl;
+
+	long misses = 0;
+	for(long j = iterations; j < iterations + WARMUP; j++) {
+		site_a(a,j);
+		if(not predicted_on(b)) misses++;
+		site_b(b,j);
+		if(not predicted_on(a)) misses++;
+	}
+	if(misses != 0)
+		std::cerr << "[" << rank << "] " << misses
+			  << " writes predicted on the wrong file" << std::endl;
+	errors += misses;
+
+	// the log is complete once Omnisc'IO is finalized
+	omniscio_finalize();
+
+	// symbols of the two sites before and after unify
+	int syms[4] = { -1, -1, -1, -1 };
+	log_reader r;
+	event e;
+	long count = 0;
+	if(not r.open(find_log(dir))) errors++;
+	else while(r.next(e)) {
+		if(e.op == OMNISCIO_WRITE) {
+			int k = (count < before ? 0 : 2)
+			      + (e.fd == (unsigned long)b.handle.posix);
+			if(syms[k] == -1) syms[k] = e.sym;
+			else if(syms[k] != e.sym) errors++;
+		}
+		count++;
+	}
+	if(syms[2] == -1 || syms[3] == -1 || syms[2] == syms[3]) errors++;
+
+	std::vector<int> all(2*size);
+	MPI_Allgather(syms+2,2,MPI_INT,&all[0],2,MPI_INT,MPI_COMM_WORLD);
+	for(int p = 0; p < size; p++) {
+		if(all[2*p] != all[0] || all[2*p+1] != all[1]) {
+			std::cerr << "[" << rank << "] rank " << p
+				  << " uses other symbols" << std::endl;
+			errors++;
+		}
+	}
+	// the call sites were first seen in another order
+	if(rank != 0 && syms[0] == syms[2]) errors++;
+
+	MPI_Finalize();
+
+	std::cout << (errors == 0 ? "OK" : "FAILED") << std::endl;
+	return errors == 0 ? 0 : 1;
+}
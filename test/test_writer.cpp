@@ -0,0 +1,187 @@
+/******************************************************************************
+ Copyright (c) 2014 ENS Rennes, Inria Rennes Bretagne Atlantique
+ All rights reserved.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+ * Neither the name of the University of California, Berkeley nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+ EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+
+
+
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "writer.hpp"
+
+using namespace omniscio;
+
+// Writes records through the writer thread into a FIFO that is not read
+// for a while: records are dropped by default and not when blocking, and
+// the FIFO only ever receives complete records, which do not fill the
+// buffers exactly. Records written below the size of a buffer reach a
+// file once the interval has elapsed.
+// Usage: test_writer [fifo]
+
+#define RECORD_SIZE	40
+#define NUM_RECORDS	8000
+#define BUFFER_SIZE	4096
+#define INTERVAL	50
+#define STALL_MS	300
+
+static void sleep_ms(long ms)
+{
+	struct timespec ts = { ms/1000, (ms%1000)*1000000 };
+	nanosleep(&ts,NULL);
+}
+
+struct slow_reader {
+	std::string	fifo;
+	std::string	data;
+};
+
+// reads the FIFO once STALL_MS have elapsed, until the writer closes it
+static void* read_slowly(void* p)
+{
+	slow_reader* r = (slow_reader*)p;
+	int fd = open(r->fifo.c_str(),O_RDONLY);
+	if(fd < 0) return NULL;
+	sleep_ms(STALL_MS);
+	char buf[4096];
+	long n;
+	while((n = read(fd,buf,sizeof(buf))) > 0) r->data.append(buf,n);
+	close(fd);
+	return NULL;
+}
+
+static void write_record(log_file& f, int i)
+{
+	char rec[RECORD_SIZE+1];
+	std::snprintf(rec,sizeof(rec),"%06d %*s\n",i,RECORD_SIZE-8,"record");
+	f << rec;
+	f.commit();
+}
+
+// writes NUM_RECORDS records into the FIFO and checks that what was read
+// is a sequence of complete records, in order
+// \return the number of records read, -1 if they are not well formed
+static int write_fifo(const std::string& fifo)
+{
+	slow_reader r;
+	r.fifo = fifo;
+	pthread_t t;
+	if(pthread_create(&t,NULL,read_slowly,&r) != 0) return -1;
+	log_file f;
+	f.open(fifo.c_str());
+	for(int i = 0; i < NUM_RECORDS; i++) write_record(f,i);
+	f.close();
+	pthread_join(t,NULL);
+
+	if(r.data.size() % RECORD_SIZE != 0) {
+		std::cout << "incomplete record in " << r.data.size()
+			  << " bytes" << std::endl;
+		return -1;
+	}
+	int count = r.data.size() / RECORD_SIZE;
+	int last = -1;
+	for(int i = 0; i < count; i++) {
+		std::string rec = r.data.substr(i*RECORD_SIZE,RECORD_SIZE);
+		int n = std::atoi(rec.c_str());
+		if(rec[RECORD_SIZE-1] != '\n' || rec.find("record") == 
+			std::string::npos || n <= last) {
+			std::cout << "record " << i << " is not well formed: "
+				  << rec << std::endl;
+			return -1;
+		}
+		last = n;
+	}
+	return count;
+}
+
+int main(int argc, char** argv)
+{
+	std::string fifo = argc > 1 ? argv[1] : "test_writer.fifo";
+	std::string filename = fifo + ".log";
+	int failures = 0;
+
+	std::remove(fifo.c_str());
+	if(mkfifo(fifo.c_str(),0600) != 0) {
+		std::cout << "could not create " << fifo << std::endl;
+		return 1;
+	}
+
+	start_writer(BUFFER_SIZE,INTERVAL,true);
+
+	// complete records are handed over at the first commit after the
+	// interval, even if the buffer is not full
+	log_file f;
+	f.open(filename.c_str());
+	write_record(f,0);
+	sleep_ms(4*INTERVAL);
+	write_record(f,1);
+	sleep_ms(4*INTERVAL);
+	struct stat s;
+	if(stat(filename.c_str(),&s) != 0 || s.st_size != 2*RECORD_SIZE) {
+		std::cout << "records not written after the interval" 
+			  << std::endl;
+		failures++;
+	}
+	f.close();
+	std::remove(filename.c_str());
+
+	int count = write_fifo(fifo);
+	if(count < 0) failures++;
+	else if(writer_dropped() == 0 || count == NUM_RECORDS) {
+		std::cout << "no record dropped while the FIFO was not read"
+			  << std::endl;
+		failures++;
+	} else if(writer_dropped() != 
+		(long long)(NUM_RECORDS - count)*RECORD_SIZE) {
+		std::cout << writer_dropped() << " bytes dropped for "
+			  << NUM_RECORDS - count << " missing records"
+			  << std::endl;
+		failures++;
+	}
+	stop_writer();
+
+	// as with OMNISCIO_WRITER_BLOCK
+	long long dropped = writer_dropped();
+	start_writer(BUFFER_SIZE,INTERVAL,false);
+	count = write_fifo(fifo);
+	if(count < 0) failures++;
+	else if(count != NUM_RECORDS || writer_dropped() != dropped) {
+		std::cout << count << " records written out of " 
+			  << NUM_RECORDS << " while blocking" << std::endl;
+		failures++;
+	}
+	stop_writer();
+
+	std::remove(fifo.c_str());
+	std::cout << (failures == 0 ? "OK" : "FAILED") << std::endl;
+	return failures == 0 ? 0 : 1;
+}